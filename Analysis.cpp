@@ -0,0 +1,87 @@
+#include "Analysis.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "Trace.h"
+#include "WorkStealingPool.h"
+
+constexpr size_t ANALYSIS_TABLE_MB = 8; // per thread
+
+struct AnalysisJob {
+  int line;
+  std::string fen;
+  std::string output{};
+  bool done = false;
+};
+
+static std::string analyze(const AnalysisJob& job, Search& search, const AnalysisSettings& settings) {
+  TRACE_SPAN("analyze_position");
+  std::string prefix = std::to_string(job.line) + ' ';
+  int size = fen_board_size(job.fen);
+  if (size < MIN_BOARD_SIZE || size > MAX_BOARD_SIZE) {
+    return prefix + "invalid position (unsupported board size)";
+  }
+  Chessboard board(false, size, settings.rules, settings.fairy_pieces);
+  if (!board.set_fen(job.fen)) {
+    return prefix + "invalid position";
+  }
+  search.clear();
+  search.clear_stop();
+  SearchResult result = search.run(board, settings.limits);
+  return prefix + (result.has_move ? board.move_to_string(result.best_move) : "(none)") +
+    " score " + score_to_string(result.score) + " depth " + std::to_string(result.depth) +
+    " nodes " + std::to_string(result.nodes) + " time " + std::to_string(result.time);
+}
+
+size_t analyze_positions(std::istream& in, std::ostream& out, const AnalysisSettings& settings,
+  LatencyHistogram* latency) {
+  std::vector<AnalysisJob> jobs;
+  std::string line;
+  for (int number = 1; std::getline(in, line); number++) {
+    line = line.substr(0, line.find('#'));
+    size_t first = line.find_first_not_of(" \t\r");
+    if (first == std::string::npos) {
+      continue;
+    }
+    size_t last = line.find_last_not_of(" \t\r");
+    jobs.push_back({ number, line.substr(first, last - first + 1) });
+  }
+
+  std::mutex mutex;
+  std::condition_variable job_done;
+  WorkStealingPool pool(settings.threads);
+  std::vector<std::unique_ptr<Search>> searches(pool.get_thread_count());
+  for (size_t i = 0; i < jobs.size(); i++) {
+    pool.submit([&, i](int worker) {
+      if (searches[worker] == nullptr) {
+        searches[worker].reset(new Search(ANALYSIS_TABLE_MB));
+      }
+      auto start = std::chrono::steady_clock::now();
+      std::string output = analyze(jobs[i], *searches[worker], settings);
+      if (latency != nullptr) {
+        latency->record(std::chrono::steady_clock::now() - start);
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      jobs[i].output = std::move(output);
+      jobs[i].done = true;
+      job_done.notify_all();
+    });
+  }
+
+  // stream the results in input order while the pool keeps working
+  for (AnalysisJob& job : jobs) {
+    std::string output;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      job_done.wait(lock, [&] { return job.done; });
+      output = std::move(job.output);
+    }
+    out << output << std::endl;
+  }
+  pool.wait();
+  return jobs.size();
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include "Chessboard.h"
+#include "Latency.h"
+#include "PieceDefinition.h"
+#include "Search.h"
+
+struct AnalysisSettings {
+  SearchLimits limits;
+  int threads = 0; // 0: one per hardware thread
+  RuleSet rules = RuleSet::CAPTURE_KING;
+  std::vector<PieceDefinition> fairy_pieces;
+};
+
+/// <summary>
+/// analyzes every position of in (one per line in get_fen's format, any
+/// board size; empty lines and '#' comments are skipped) on a work-stealing
+/// thread pool and writes one line per position to out, in input order and
+/// as soon as the position and all before it are done:
+///
+///   &lt;line&gt; &lt;best move|(none)&gt; score &lt;cp n|mate n&gt; depth &lt;n&gt; nodes &lt;n&gt; time &lt;ms&gt;
+///
+/// Every position starts with an empty transposition table, so the results
+/// do not depend on the number of threads. Returns the number of positions;
+/// the time of every search goes to latency (if given).
+/// </summary>
+size_t analyze_positions(std::istream& in, std::ostream& out, const AnalysisSettings& settings,
+  LatencyHistogram* latency = nullptr);
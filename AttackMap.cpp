@@ -0,0 +1,117 @@
+#include "AttackMap.h"
+
+#include <algorithm>
+
+#include "Chessboard.h"
+#include "Chesspiece.h"
+
+static void add_unique(std::vector<Offset>& steps, const std::vector<Offset>& new_steps) {
+  for (const Offset& step : new_steps) {
+    if (std::find(steps.begin(), steps.end(), step) == steps.end()) {
+      steps.push_back(step);
+    }
+  }
+}
+
+AttackMap::AttackMap(int size)
+  : size(size),
+  white_attacks(size * size, 0),
+  black_attacks(size * size, 0) {}
+
+/// <summary>
+/// recomputes all counts from scratch (only needed once per position setup)
+/// </summary>
+void AttackMap::reset(const Chessboard& cb) {
+  std::fill(white_attacks.begin(), white_attacks.end(), 0);
+  std::fill(black_attacks.begin(), black_attacks.end(), 0);
+  ray_directions.clear();
+  leap_offsets.clear();
+  for (int color = 0; color < 2; color++) {
+    for (int square : cb.get_piece_squares(color == 1)) {
+      const MovePattern& pattern = cb.piece_at(square)->get_pattern();
+      add_unique(ray_directions, pattern.rides);
+      add_unique(leap_offsets, pattern.leaps);
+      add_unique(leap_offsets, pattern.captures);
+      add_piece(cb, square % size, square / size);
+    }
+  }
+}
+
+void AttackMap::change_piece(const Chessboard& cb, int row, int col, int delta) {
+  const Chesspiece* cp = cb(row, col);
+  if (cp == nullptr) {
+    return;
+  }
+  bool is_white = cp->is_white();
+  const MovePattern& pattern = cp->get_pattern();
+  std::vector<int>& counts = is_white ? white_attacks : black_attacks;
+  const CompiledPattern* tables_of = cb.get_tables().get(pattern);
+  CompiledPattern missing;
+  if (tables_of == nullptr) { // see Chessboard::add_pseudo_moves
+    missing = cb.get_tables().compile(pattern);
+    tables_of = &missing;
+  }
+  const CompiledPattern& compiled = *tables_of;
+  int square = col * size + row;
+  for (int i = compiled.leaps.first[square]; i < compiled.leaps.first[square + 1]; i++) {
+    counts[compiled.leaps.targets[i]] += delta;
+  }
+  for (int i = compiled.captures.first[square]; i < compiled.captures.first[square + 1]; i++) {
+    counts[compiled.captures.targets[i]] += delta;
+  }
+  const Occupant* mailbox = cb.get_mailbox();
+  for (const Offset& step : pattern.rides) {
+    int box_step = cb.mailbox_step(step);
+    int square_step = step.col * size + step.row;
+    int box = cb.to_mailbox(square) + box_step;
+    int target = square + square_step;
+    while (mailbox[box] != Occupant::BORDER) {
+      counts[target] += delta;
+      if (mailbox[box] != Occupant::EMPTY) {
+        break;
+      }
+      box += box_step;
+      target += square_step;
+    }
+  }
+}
+
+/// <summary>
+/// for every ride direction: find the first piece looking at row/col along
+/// that direction and extend (delta = 1) or cut (delta = -1) its ray behind
+/// row/col up to and including the next blocker
+/// </summary>
+void AttackMap::change_rays_through(const Chessboard& cb, int row, int col, int delta) {
+  const Occupant* mailbox = cb.get_mailbox();
+  int square = col * size + row;
+  int origin = cb.to_mailbox(square);
+  for (const Offset& step : ray_directions) {
+    int box_step = cb.mailbox_step(step);
+    int square_step = step.col * size + step.row;
+    int box = origin - box_step;
+    int k = 1;
+    while (mailbox[box] == Occupant::EMPTY) {
+      box -= box_step;
+      k++;
+    }
+    if (mailbox[box] == Occupant::BORDER) {
+      continue;
+    }
+    const Chesspiece* slider = cb.piece_at(square - k * square_step);
+    const std::vector<Offset>& rides = slider->get_pattern().rides;
+    if (std::find(rides.begin(), rides.end(), step) == rides.end()) {
+      continue;
+    }
+    std::vector<int>& counts = slider->is_white() ? white_attacks : black_attacks;
+    box = origin + box_step;
+    int target = square + square_step;
+    while (mailbox[box] != Occupant::BORDER) {
+      counts[target] += delta;
+      if (mailbox[box] != Occupant::EMPTY) {
+        break;
+      }
+      box += box_step;
+      target += square_step;
+    }
+  }
+}
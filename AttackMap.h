@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+
+#include "MovePattern.h"
+
+class Chessboard;
+class Chesspiece;
+
+/// <summary>
+/// keeps for every square the number of white and black pieces attacking it.
+/// The counts are updated incrementally: a move only touches the attacks of
+/// the moved/captured piece and the sliders whose rays run through the
+/// vacated or occupied square. Rays are walked on the board's mailbox.
+/// </summary>
+class AttackMap {
+private:
+  int size;
+  std::vector<int> white_attacks;
+  std::vector<int> black_attacks;
+  std::vector<Offset> ray_directions; // every ride step of the pieces on the board
+  std::vector<Offset> leap_offsets;   // every leap/capture step of the pieces on the board
+
+  void change_piece(const Chessboard& cb, int row, int col, int delta);
+  void change_rays_through(const Chessboard& cb, int row, int col, int delta);
+
+public:
+  AttackMap(int size);
+
+  void reset(const Chessboard& cb);
+  int count(int row, int col, bool by_white) const {
+    return by_white ? white_attacks[col * size + row] : black_attacks[col * size + row];
+  }
+  const std::vector<Offset>& get_ray_directions() const { return ray_directions; }
+  const std::vector<Offset>& get_leap_offsets() const { return leap_offsets; }
+
+  // the piece standing on row/col starts/stops attacking
+  void add_piece(const Chessboard& cb, int row, int col) { change_piece(cb, row, col, 1); }
+  void remove_piece(const Chessboard& cb, int row, int col) { change_piece(cb, row, col, -1); }
+  // row/col was just emptied: sliders looking at it now see further
+  void open_square(const Chessboard& cb, int row, int col) { change_rays_through(cb, row, col, 1); }
+  // row/col is empty but about to be occupied: sliders looking at it get cut off
+  void close_square(const Chessboard& cb, int row, int col) { change_rays_through(cb, row, col, -1); }
+};
@@ -0,0 +1,308 @@
+#include "BatchBoards.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Trace.h"
+#include "Zobrist.h"
+
+BatchBoards::BatchBoards(int board_count, int size, const std::vector<PieceDefinition>& fairy_pieces,
+  uint64_t seed)
+  : board_count(board_count),
+  size(size) {
+  // the mailbox geometry of a board of this configuration
+  Chessboard layout(false, size, RuleSet::CAPTURE_KING, fairy_pieces);
+  width = layout.get_mailbox_width();
+  pad = (width - size) / 2;
+  cells_per_board = width * width;
+
+  std::fill(std::begin(occupants), std::end(occupants), Occupant::BORDER);
+  occupants[EMPTY] = Occupant::EMPTY;
+
+  cells.assign(static_cast<size_t>(board_count) * cells_per_board, BORDER);
+  slots.resize(static_cast<size_t>(board_count) * cells_per_board);
+  pieces.resize(static_cast<size_t>(board_count) * 2 * size * size);
+  piece_count.resize(board_count * 2);
+  essential.resize(board_count * 2);
+  in_play.resize(board_count);
+  whites_turn.resize(board_count);
+  quiet_plies.resize(board_count);
+  plies.resize(board_count);
+  game.resize(board_count);
+  random_state.resize(board_count);
+  finished.resize(board_count);
+  move_first.resize(board_count);
+  move_count.resize(board_count);
+  chosen.resize(board_count);
+  for (int board = 0; board < board_count; board++) {
+    random_state[board] = zobrist_mix(seed + board) | 1; // xorshift must not start at 0
+  }
+}
+
+/// <summary>
+/// the cell value of a figure; new figures get their pattern resolved to
+/// steps in the mailbox
+/// </summary>
+int BatchBoards::type_of(const Chesspiece& cp) {
+  for (size_t i = 0; i < types.size(); i++) {
+    if (types[i].letter == cp.get_letter() && types[i].is_white == cp.is_white()) {
+      return static_cast<int>(i) + 1;
+    }
+  }
+  const MovePattern& pattern = cp.get_pattern();
+  auto steps = [this](const std::vector<Offset>& offsets) {
+    std::vector<int> result;
+    for (const Offset& offset : offsets) {
+      result.push_back(offset.col * width + offset.row);
+    }
+    return result;
+  };
+  int most_moves = static_cast<int>(pattern.leaps.size() + pattern.captures.size() + pattern.quiet_leaps.size() +
+    pattern.rides.size() * (size - 1)) + (pattern.pawn_push ? 2 : 0);
+  types.push_back({ cp.get_letter(), cp.is_white(), cp.is_essential(), pattern.pawn_push, most_moves,
+    steps(pattern.leaps), steps(pattern.rides), steps(pattern.captures), steps(pattern.quiet_leaps) });
+  int value = static_cast<int>(types.size());
+  occupants[value] = cp.is_white() ? Occupant::WHITE : Occupant::BLACK;
+  return value;
+}
+
+BatchBoards::StartPosition BatchBoards::make_start(const Chessboard& position) {
+  StartPosition start;
+  start.cells.assign(cells_per_board, BORDER);
+  start.essential[0] = start.essential[1] = 0;
+  for (int color = 0; color < 2; color++) {
+    for (int square : position.get_piece_squares(color == 1)) {
+      const Chesspiece& cp = *position.piece_at(square);
+      int cell = position.to_mailbox(square);
+      start.cells[cell] = static_cast<uint8_t>(type_of(cp));
+      start.pieces[color].push_back(static_cast<uint16_t>(cell));
+      start.essential[color] += cp.is_essential() ? 1 : 0;
+    }
+  }
+  for (int square = 0; square < size * size; square++) {
+    if (position.piece_at(square) == nullptr) {
+      start.cells[position.to_mailbox(square)] = EMPTY;
+    }
+  }
+  start.whites_turn = position.is_whites_turn();
+  return start;
+}
+
+bool BatchBoards::add_start_position(const Chessboard& position, uint64_t games) {
+  if (position.get_size() != size || position.get_mailbox_width() != width) {
+    return false;
+  }
+  StartPosition start = make_start(position);
+  start.first = games_queued;
+  start.remaining = games;
+  games_queued += games;
+  start_positions.push_back(std::move(start));
+  return true;
+}
+
+bool BatchBoards::generate_moves(const Chessboard& position, std::vector<Move>& position_moves) {
+  position_moves.clear();
+  if (position.get_size() != size || position.get_mailbox_width() != width) {
+    return false;
+  }
+  load(0, make_start(position));
+  moves_used = 0;
+  generate(0);
+  for (uint32_t i = 0; i < move_count[0]; i++) {
+    uint32_t move = moves[move_first[0] + i];
+    int from = move >> 16, to = move & 0xFFFF;
+    position_moves.push_back({ (from / width - pad) * size + from % width - pad,
+      (to / width - pad) * size + to % width - pad });
+  }
+  in_play[0] = 0;
+  return true;
+}
+
+/// <summary>
+/// puts the next queued game on the board (or leaves it out of play)
+/// </summary>
+void BatchBoards::refill(int board) {
+  while (!start_positions.empty() && start_positions.front().remaining == 0) {
+    start_positions.pop_front();
+  }
+  if (start_positions.empty()) {
+    in_play[board] = 0;
+    return;
+  }
+  StartPosition& start = start_positions.front();
+  load(board, start);
+  game[board] = start.first++;
+  start.remaining--;
+  in_play[board] = 1;
+}
+
+// copies the position onto the board
+void BatchBoards::load(int board, const StartPosition& start) {
+  size_t offset = static_cast<size_t>(board) * cells_per_board;
+  std::memcpy(&cells[offset], start.cells.data(), cells_per_board);
+  for (int color = 0; color < 2; color++) {
+    uint16_t* list = &pieces[(static_cast<size_t>(board) * 2 + color) * size * size];
+    const std::vector<uint16_t>& squares = start.pieces[color];
+    for (size_t i = 0; i < squares.size(); i++) {
+      list[i] = squares[i];
+      slots[offset + squares[i]] = static_cast<uint16_t>(i);
+    }
+    piece_count[board * 2 + color] = static_cast<uint16_t>(squares.size());
+    essential[board * 2 + color] = start.essential[color];
+  }
+  whites_turn[board] = start.whites_turn;
+  quiet_plies[board] = 0;
+  plies[board] = 0;
+  finished[board] = static_cast<uint8_t>(GameState::PLAY_ON);
+}
+
+/// <summary>
+/// appends all moves of the player on turn to the move buffer (the same
+/// moves as Chessboard::generate_moves with RuleSet::CAPTURE_KING)
+/// </summary>
+void BatchBoards::generate(int board) {
+  const uint8_t* board_cells = &cells[static_cast<size_t>(board) * cells_per_board];
+  int color = whites_turn[board];
+  Occupant enemy = color == 1 ? Occupant::BLACK : Occupant::WHITE;
+  const uint16_t* list = &pieces[(static_cast<size_t>(board) * 2 + color) * size * size];
+  // room for the most moves the figures could have, so the loops below
+  // write without checking the capacity
+  size_t most = 0;
+  for (int i = 0; i < piece_count[board * 2 + color]; i++) {
+    most += types[board_cells[list[i]] - 1].most_moves;
+  }
+  if (moves.size() < moves_used + most) {
+    moves.resize(2 * (moves_used + most));
+  }
+  uint32_t* out = moves.data() + moves_used;
+  uint32_t* next = out;
+  for (int i = 0; i < piece_count[board * 2 + color]; i++) {
+    int from = list[i];
+    const PieceType& type = types[board_cells[from] - 1];
+    uint32_t origin = static_cast<uint32_t>(from) << 16;
+    // every target is written, but only kept if the move is allowed: random
+    // boards make these conditions unpredictable for the branch predictor
+    for (int step : type.leaps) {
+      Occupant target = occupants[board_cells[from + step]];
+      *next = origin | (from + step);
+      next += target == Occupant::EMPTY || target == enemy;
+    }
+    for (int step : type.captures) {
+      *next = origin | (from + step);
+      next += occupants[board_cells[from + step]] == enemy;
+    }
+    for (int step : type.quiet_leaps) {
+      *next = origin | (from + step);
+      next += board_cells[from + step] == EMPTY;
+    }
+    for (int step : type.rides) {
+      int to = from + step;
+      while (board_cells[to] == EMPTY) {
+        *next++ = origin | to;
+        to += step;
+      }
+      *next = origin | to;
+      next += occupants[board_cells[to]] == enemy;
+    }
+    if (type.pawn_push) {
+      int forward = color == 1 ? -width : width;
+      int initial_col = color == 1 ? size - 2 : 1;
+      if (board_cells[from + forward] == EMPTY) {
+        *next++ = origin | (from + forward);
+        if (from / width - pad == initial_col && board_cells[from + 2 * forward] == EMPTY) {
+          *next++ = origin | (from + 2 * forward);
+        }
+      }
+    }
+  }
+  move_first[board] = static_cast<uint32_t>(moves_used);
+  move_count[board] = static_cast<uint32_t>(next - out);
+  moves_used += move_count[board];
+}
+
+void BatchBoards::apply(int board) {
+  size_t offset = static_cast<size_t>(board) * cells_per_board;
+  int from = chosen[board] >> 16;
+  int to = chosen[board] & 0xFFFF;
+  int color = whites_turn[board];
+  uint8_t target = cells[offset + to];
+  if (target != EMPTY) {
+    // the captured figure leaves its list, the last one takes its place
+    int enemy = board * 2 + 1 - color;
+    uint16_t* list = &pieces[static_cast<size_t>(enemy) * size * size];
+    uint16_t slot = slots[offset + to];
+    uint16_t last = list[--piece_count[enemy]];
+    list[slot] = last;
+    slots[offset + last] = slot;
+    essential[enemy] -= types[target - 1].is_essential ? 1 : 0;
+    quiet_plies[board] = 0;
+  }
+  else {
+    quiet_plies[board]++;
+  }
+  uint16_t slot = slots[offset + from];
+  pieces[(static_cast<size_t>(board) * 2 + color) * size * size + slot] = static_cast<uint16_t>(to);
+  slots[offset + to] = slot;
+  cells[offset + to] = cells[offset + from];
+  cells[offset + from] = EMPTY;
+  whites_turn[board] = static_cast<uint8_t>(1 - color);
+  plies[board]++;
+}
+
+int BatchBoards::step() {
+  TRACE_SPAN("batch_step");
+  for (int board = 0; board < board_count; board++) {
+    if (!in_play[board]) {
+      refill(board);
+    }
+  }
+
+  moves_used = 0;
+  for (int board = 0; board < board_count; board++) {
+    if (in_play[board]) {
+      generate(board);
+    }
+    else {
+      move_count[board] = 0;
+    }
+  }
+
+  // pick a move per board: xorshift, scaled to the move count without a division
+  for (int board = 0; board < board_count; board++) {
+    uint64_t random = random_state[board];
+    random ^= random << 13;
+    random ^= random >> 7;
+    random ^= random << 17;
+    random_state[board] = random;
+    uint32_t count = move_count[board];
+    uint32_t index = static_cast<uint32_t>(((random >> 32) * count) >> 32);
+    chosen[board] = count > 0 ? moves[move_first[board] + index] : 0;
+  }
+
+  for (int board = 0; board < board_count; board++) {
+    if (in_play[board] && move_count[board] > 0) {
+      apply(board);
+      total_plies++;
+    }
+  }
+
+  // game over, in the order of Chessboard::is_game_over
+  for (int board = 0; board < board_count; board++) {
+    GameState state = essential[board * 2] == 0 ? GameState::BLACK_LOST
+      : essential[board * 2 + 1] == 0 ? GameState::WHITE_LOST
+      : move_count[board] == 0 ? GameState::STALEMATE
+      : no_capture_limit > 0 && quiet_plies[board] >= no_capture_limit ? GameState::DRAW_BY_NO_CAPTURE
+      : GameState::PLAY_ON;
+    finished[board] = in_play[board] ? static_cast<uint8_t>(state) : static_cast<uint8_t>(GameState::PLAY_ON);
+  }
+
+  int playing = 0;
+  for (int board = 0; board < board_count; board++) {
+    if (finished[board] != static_cast<uint8_t>(GameState::PLAY_ON)) {
+      results.push_back({ game[board], static_cast<GameState>(finished[board]), plies[board] });
+      refill(board);
+    }
+    playing += in_play[board];
+  }
+  return playing;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "Chessboard.h"
+#include "PieceDefinition.h"
+
+// how a game of the batch ended; position counts the games handed to
+// add_start_position, in that order
+struct BatchResult {
+  uint64_t position;
+  GameState result;
+  int plies;
+};
+
+/// <summary>
+/// plays random games (uniform over the moves, like the playouts of the mcts
+/// player) on many boards at once. The boards are kept as a structure of
+/// arrays: one array per field, every field of a board at board * stride,
+/// squares in the padded mailbox layout of Chessboard. A call of step()
+/// advances all boards one ply in phases that each run over all boards
+/// (generate, pick, apply, game over, refill), so the short loops over the
+/// boards have no per-board objects or branches on the piece class.
+///
+/// The rules are those of the pieces' MovePatterns with RuleSet::CAPTURE_KING:
+/// a game ends when an essential figure is lost, the player on turn cannot
+/// move (STALEMATE) or after the no-capture limit. Repetitions are not looked
+/// for; the no-capture limit ends those games anyway.
+/// </summary>
+class BatchBoards {
+private:
+  static constexpr uint8_t EMPTY = 0;
+  static constexpr uint8_t BORDER = 0xFF;
+
+  // a figure of one color; cells hold 1 + its index in types
+  struct PieceType {
+    char letter;
+    bool is_white;
+    bool is_essential;
+    bool pawn_push;
+    int most_moves;         // on an empty board
+    std::vector<int> leaps; // steps in the mailbox
+    std::vector<int> rides;
+    std::vector<int> captures;
+    std::vector<int> quiet_leaps;
+  };
+
+  struct StartPosition {
+    std::vector<uint8_t> cells;
+    std::vector<uint16_t> pieces[2]; // mailbox indices, [0] black and [1] white
+    uint8_t essential[2];
+    bool whites_turn;
+    uint64_t first;     // number of the first game
+    uint64_t remaining; // games still to start from it
+  };
+
+  int board_count;
+  int size;
+  int pad;
+  int width;    // of the mailbox
+  int cells_per_board;
+  int no_capture_limit = NO_CAPTURE_LIMIT;
+  std::vector<PieceType> types;
+  Occupant occupants[256];           // color of every cell value
+  std::deque<StartPosition> start_positions;
+  uint64_t games_queued = 0;
+
+  // per cell: cells[board * cells_per_board + cell]
+  std::vector<uint8_t> cells;
+  std::vector<uint16_t> slots;       // place of a figure in its piece list
+  // per color: pieces[(board * 2 + color) * size * size + i] (no color has more figures than squares)
+  std::vector<uint16_t> pieces;
+  std::vector<uint16_t> piece_count; // [board * 2 + color]
+  std::vector<uint8_t> essential;    // [board * 2 + color]
+  // per board
+  std::vector<uint8_t> in_play;
+  std::vector<uint8_t> whites_turn;
+  std::vector<int> quiet_plies;
+  std::vector<int> plies;
+  std::vector<uint64_t> game;
+  std::vector<uint64_t> random_state;
+  std::vector<uint8_t> finished;     // GameState, PLAY_ON while running
+  std::vector<uint32_t> move_first;  // moves of the board in the move buffer
+  std::vector<uint32_t> move_count;
+  std::vector<uint32_t> chosen;      // from << 16 | to, both mailbox indices
+  std::vector<uint32_t> moves;       // of all boards, the first moves_used are valid
+  size_t moves_used = 0;
+  std::vector<BatchResult> results;
+  uint64_t total_plies = 0;
+
+  int type_of(const Chesspiece& cp);
+  StartPosition make_start(const Chessboard& position);
+  void load(int board, const StartPosition& start);
+  void generate(int board);
+  void apply(int board);
+  void refill(int board);
+
+public:
+  // size and fairy pieces as for Chessboard; seed makes the games repeatable
+  BatchBoards(int board_count, int size, const std::vector<PieceDefinition>& fairy_pieces = {},
+    uint64_t seed = 1);
+
+  // queues games from the position; false if it has another size or
+  // other fairy pieces than the batch
+  bool add_start_position(const Chessboard& position, uint64_t games = 1);
+  // moves of both players without a capture until a draw, 0: no limit
+  void set_no_capture_limit(int plies) { no_capture_limit = plies; }
+  // the moves the batch generates in the position (squares as in Move), to
+  // check them against Chessboard::generate_moves; overwrites the first
+  // board, so only for a batch that is not playing. False if the position
+  // does not fit the batch
+  bool generate_moves(const Chessboard& position, std::vector<Move>& position_moves);
+
+  // plays one ply on every board; finished boards take the next queued game.
+  // Returns the number of boards still in play (0: all games done)
+  int step();
+  // the games finished so far, in the order they ended
+  const std::vector<BatchResult>& get_results() const { return results; }
+  void clear_results() { results.clear(); }
+  uint64_t get_total_plies() const { return total_plies; }
+  int get_board_count() const { return board_count; }
+};
@@ -1,41 +1,207 @@
 #include "Chessboard.h"
 
 #include <iostream>
-#include <iomanip> // for cout setw
+#include <iomanip> // for setw
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+#include "GameRecord.h"
+#include "Stats.h"
+#include "Trace.h"
+#include "Zobrist.h"
 
-using std::cout;
 using std::endl;
 
 //#define DEBUGOUTPUT true
-#define DEBUG(X) cout << std::boolalpha << (#X) << " = " << (X) << endl
+#define DEBUG(X) std::cerr << std::boolalpha << (#X) << " = " << (X) << endl
+
+const char* error_message(ChessError error) {
+  switch (error) {
+  case ChessError::NONE:
+    return "no error";
+  case ChessError::INVALID_SIZE:
+    return "the board must have a size of at least 8 and maximum of 26";
+  case ChessError::INVALID_START_SQUARE:
+    return "a start square of a fairy piece is not on the board";
+  case ChessError::FILE_NOT_OPENED:
+    return "the file could not be opened";
+  case ChessError::NOT_A_GAME_RECORD:
+    return "the file is no game record";
+  case ChessError::DAMAGED_GAME_RECORD:
+    return "the game record is damaged";
+  case ChessError::ILLEGAL_MOVE:
+    return "a move was not legal and was left out";
+  case ChessError::NOT_AN_OPENING_BOOK:
+    return "the file is no opening book";
+  }
+  return "unknown error";
+}
+
+/// <summary>
+/// the mailbox border must be as wide as the longest step of any piece, so
+/// that no walk or leap from a square of the board can jump over it
+/// </summary>
+static int mailbox_pad(const std::vector<PieceDefinition>& fairy_pieces) {
+  int pad = 2; // knight, hopper and quadrilateral
+  for (const PieceDefinition& definition : fairy_pieces) {
+    for (const std::vector<Offset>* steps : { &definition.pattern->leaps, &definition.pattern->rides,
+      &definition.pattern->captures, &definition.pattern->quiet_leaps }) {
+      for (const Offset& step : *steps) {
+        pad = std::max(pad, std::max(std::abs(step.row), std::abs(step.col)));
+      }
+    }
+  }
+  return pad;
+}
+
+static Occupant occupant_of(const Chesspiece* cp) {
+  if (cp == nullptr) {
+    return Occupant::EMPTY;
+  }
+  return cp->is_white() ? Occupant::WHITE : Occupant::BLACK;
+}
+
+// the occupant a piece of the given color may capture
+static Occupant enemy_of(bool is_white) {
+  return is_white ? Occupant::BLACK : Occupant::WHITE;
+}
 
-Chessboard::Chessboard(bool use_utf8, int size)
-  : size(size),
+Chessboard::Chessboard(bool use_utf8, int requested_size, RuleSet rules,
+  const std::vector<PieceDefinition>& fairy_pieces)
+  : size(std::min(std::max(requested_size, MIN_BOARD_SIZE), MAX_BOARD_SIZE)),
   use_utf8(use_utf8),
+  rules(rules),
   selected(nullptr),
-  chesspieces(new Chesspiece* [size * size]()) {
-  if (size < 8 || size > 26) {
-    std::cerr << "Chessboard must have a size of at least 8 and maximum of 26."
-      << std::endl;
-    exit(-1);
+  chesspieces(new Chesspiece* [size * size]()),
+  piece_index(size * size, -1),
+  fairy_pieces(fairy_pieces),
+  pad(mailbox_pad(fairy_pieces)),
+  mailbox_width(size + 2 * pad),
+  mailbox(mailbox_width * mailbox_width, Occupant::BORDER),
+  mailbox_index(size * size),
+  tables(size),
+  attacks(nullptr) {
+  if (size != requested_size) {
+    error = ChessError::INVALID_SIZE;
+  }
+  for (int square = 0; square < size * size; square++) {
+    mailbox_index[square] = (square / size + pad) * mailbox_width + square % size + pad;
   }
 
   place_figures();
+  place_fairy_pieces();
+  setup_position();
+}
+
+Chessboard::Chessboard(const Chessboard& other)
+  : size(other.size),
+  whites_turn(other.whites_turn),
+  use_utf8(other.use_utf8),
+  rules(other.rules),
+  selected(other.selected != nullptr ? new Position(*other.selected) : nullptr),
+  chesspieces(new Chesspiece* [other.size * other.size]()),
+  piece_index(other.piece_index),
+  fairy_pieces(other.fairy_pieces),
+  pad(other.pad),
+  mailbox_width(other.mailbox_width),
+  mailbox(other.mailbox),
+  mailbox_index(other.mailbox_index),
+  tables(other.tables),
+  attacks(other.attacks != nullptr ? new AttackMap(*other.attacks) : nullptr),
+  legal_moves(other.legal_moves),
+  legal_moves_valid(other.legal_moves_valid),
+  hash(other.hash),
+  history(other.history),
+  quiet_plies(other.quiet_plies),
+  no_capture_limit(other.no_capture_limit),
+  error(other.error) {
+  for (int color = 0; color < 2; color++) {
+    piece_squares[color] = other.piece_squares[color];
+    for (int square : piece_squares[color]) {
+      chesspieces[square] = other.chesspieces[square]->clone();
+    }
+  }
 }
 
 Chessboard::~Chessboard() {
   if (chesspieces != nullptr) {
-    for (size_t i = 0; i < size * size; i++)
-    {
-      Chesspiece* cp = chesspieces[i];
-      if (cp != nullptr) {
-        delete cp;
+    for (int color = 0; color < 2; color++) {
+      for (int square : piece_squares[color]) {
+        delete chesspieces[square];
       }
     }
     delete[] chesspieces;
     chesspieces = nullptr;
   }
+  delete attacks;
+  attacks = nullptr;
+  delete selected;
+  selected = nullptr;
 }
+
+/// <summary>
+/// prepares everything derived from the figures on the board: mailbox, piece
+/// lists, leap tables, attack map and position key; the history starts anew
+/// </summary>
+void Chessboard::setup_position() {
+  hash = whites_turn ? 0 : ZOBRIST_BLACK_TO_MOVE;
+  history.clear();
+  quiet_plies = 0;
+  piece_squares[0].clear();
+  piece_squares[1].clear();
+  std::fill(piece_index.begin(), piece_index.end(), -1);
+  for (int i = 0; i < size * size; i++) {
+    const Chesspiece* cp = chesspieces[i];
+    mailbox[mailbox_index[i]] = occupant_of(cp);
+    if (cp != nullptr) {
+      list_add(i);
+      tables.add(cp->get_pattern());
+      hash ^= zobrist_piece(cp->get_letter(), cp->is_white(), i);
+    }
+  }
+  if (rules == RuleSet::CHECKMATE) {
+    if (attacks == nullptr) {
+      attacks = new AttackMap(size);
+    }
+    attacks->reset(*this);
+  }
+  legal_moves_valid = false;
+}
+
+/// <summary>
+/// adds the figure on square to the list of its color
+/// </summary>
+void Chessboard::list_add(int square) {
+  std::vector<int>& squares = piece_squares[chesspieces[square]->is_white()];
+  piece_index[square] = static_cast<int>(squares.size());
+  squares.push_back(square);
+}
+
+/// <summary>
+/// removes the figure on square from its list; the last entry takes its place
+/// </summary>
+void Chessboard::list_remove(int square) {
+  std::vector<int>& squares = piece_squares[chesspieces[square]->is_white()];
+  int index = piece_index[square];
+  squares[index] = squares.back();
+  piece_index[squares[index]] = index;
+  squares.pop_back();
+  piece_index[square] = -1;
+}
+
+void Chessboard::put(int square, Chesspiece* cp) {
+  chesspieces[square] = cp;
+  mailbox[mailbox_index[square]] = occupant_of(cp);
+}
+
+void Chessboard::list_move(int from, int to) {
+  int index = piece_index[from];
+  piece_squares[chesspieces[from]->is_white()][index] = to;
+  piece_index[to] = index;
+  piece_index[from] = -1;
+}
+
 /// <summary>
 /// maps a user inputed row (A-Z) to our internal representation (0-25)
 /// </summary>
@@ -53,21 +219,19 @@ int Chessboard::mapUserRow(int row) const {
 /// </summary>
 int Chessboard::mapUserCol(int col) const { return get_size() - col; }
 
-GameState Chessboard::is_game_over() const {
+GameState Chessboard::is_game_over() {
+  TRACE_SPAN("is_game_over");
+  COUNT_STAT(Counter::GAME_OVER_SCAN);
   size_t black_essential = 0;
   size_t white_essential = 0;
-  for (size_t i = 0; i < size * size; i++)
-  {
-    Chesspiece* cp = chesspieces[i];
-    if (cp != nullptr) {
-      if (cp->is_essential()) {
-        if (cp->is_white()) {
-          white_essential++;
-        }
-        else {
-          black_essential++;
-        }
-      }
+  for (int square : piece_squares[0]) {
+    if (chesspieces[square]->is_essential()) {
+      black_essential++;
+    }
+  }
+  for (int square : piece_squares[1]) {
+    if (chesspieces[square]->is_essential()) {
+      white_essential++;
     }
   }
   if (black_essential == 0) {
@@ -76,9 +240,35 @@ GameState Chessboard::is_game_over() const {
   else if (white_essential == 0) {
     return GameState::WHITE_LOST;
   }
+  if (rules == RuleSet::CHECKMATE && get_legal_moves().empty()) {
+    if (!in_check()) {
+      return GameState::STALEMATE;
+    }
+    return is_whites_turn() ? GameState::WHITE_CHECKMATED : GameState::BLACK_CHECKMATED;
+  }
+  if (no_capture_limit_reached()) {
+    return GameState::DRAW_BY_NO_CAPTURE;
+  }
+  if (repetitions() >= REPETITION_DRAW - 1) {
+    return GameState::DRAW_BY_REPETITION;
+  }
   return GameState::PLAY_ON;
 }
 
+int Chessboard::repetitions() const {
+  int count = 0;
+  // history[i] is the position before move i; the oldest one after the last
+  // capture is history.size() - quiet_plies, and only every second one has
+  // the same player on turn
+  int oldest = static_cast<int>(history.size()) - quiet_plies;
+  for (int i = static_cast<int>(history.size()) - 2; i >= oldest; i -= 2) {
+    if (history[i].hash == hash) {
+      count++;
+    }
+  }
+  return count;
+}
+
 /// <summary>
 /// gets the chesspiece on the given row/col square
 /// </summary>
@@ -87,7 +277,9 @@ const Chesspiece* Chessboard::operator()(int row, int col) const {
 }
 
 bool Chessboard::can_pass_over(int row, int col) const {
-  return (*this)(row, col) == nullptr;
+  COUNT_STAT(Counter::CAN_PASS_OVER);
+  // squares up to pad beyond the edge are border, never free
+  return mailbox[(col + pad) * mailbox_width + row + pad] == Occupant::EMPTY;
 }
 
 bool Chessboard::can_land_on(int row, int col, bool is_white) const {
@@ -155,15 +347,36 @@ void Chessboard::place_figures() {
   //chesspieces[userAt('E', 5)] = quadrilateral_white;
 }
 
-bool Chessboard::can_capture_on(int row, int col, bool is_white) const {
-  const Chesspiece* cp = (*this)(row, col);
-  if (cp == nullptr || cp->is_white() == is_white) {
-    return false;
+/// <summary>
+/// places the data-driven pieces on their start squares (white as given,
+/// black mirrored); they replace whatever figure stood there
+/// </summary>
+void Chessboard::place_fairy_pieces() {
+  for (const PieceDefinition& definition : fairy_pieces) {
+    for (const std::string& square : definition.start_squares) {
+      int row = square.empty() ? 0 : std::toupper(square[0]);
+      int col = square.size() > 1 ? std::atoi(square.c_str() + 1) : 0;
+      if (row < 'A' || row >= 'A' + size || col < 1 || col > size) {
+        if (error == ChessError::NONE) {
+          error = ChessError::INVALID_START_SQUARE;
+        }
+        continue;
+      }
+      int squares[] = { userAt(row, col), userAt(row, size + 1 - col) };
+      for (int i = 0; i < 2; i++) {
+        delete chesspieces[squares[i]];
+        chesspieces[squares[i]] = new FairyPiece{ definition.symbol, i == 0, definition.pattern };
+      }
+    }
   }
-  return true;
 }
 
-bool Chessboard::can_select_piece(int row, int col) const {
+bool Chessboard::can_capture_on(int row, int col, bool is_white) const {
+  return mailbox[(col + pad) * mailbox_width + row + pad] == enemy_of(is_white);
+}
+
+bool Chessboard::can_select_piece(int row, int col) {
+  TRACE_SPAN("can_select_piece");
   int user_row = mapUserRow(row);
   int user_col = mapUserCol(col);
   const Chesspiece* cp = (*this)(user_row, user_col);
@@ -176,18 +389,19 @@ bool Chessboard::can_select_piece(int row, int col) const {
     return false;
   }
 
-  // check if figure can move at all
-  for (size_t to_row = 0; to_row < get_size(); to_row++) {
-    for (size_t to_col = 0; to_col < get_size(); to_col++) {
-      if (cp->can_move(user_row, user_col, to_row, to_col, *this)) {
-        return true;
-      }
+  // check if figure can move at all (without CHECKMATE rules the generated
+  // moves are the ones can_move allows)
+  int from = at(user_row, user_col);
+  for (const Move& move : get_legal_moves()) {
+    if (move.from == from) {
+      return true;
     }
   }
   return false;
 }
 
-bool Chessboard::can_move_selection_to(int row, int col) const {
+bool Chessboard::can_move_selection_to(int row, int col) {
+  TRACE_SPAN("can_move_selection_to");
   if (selected == nullptr) {
     return false;
   }
@@ -195,12 +409,12 @@ bool Chessboard::can_move_selection_to(int row, int col) const {
 }
 
 bool Chessboard::can_move(int from_row, int from_col, int to_row,
-  int to_col) const {
+  int to_col) {
   const Chesspiece* cp = get_selected_chesspiece();
   if (cp == nullptr) {
     return false;
   }
-  return cp->can_move(from_row, from_col, mapUserRow(to_row), mapUserCol(to_col), *this);
+  return can_reach(from_row, from_col, mapUserRow(to_row), mapUserCol(to_col));
 }
 
 void Chessboard::select_piece(int row, int col) {
@@ -233,72 +447,622 @@ void Chessboard::move_selection_to(int row, int col) {
   if (sel_cp == nullptr) {
     return;
   }
-  // remove from current square
-  chesspieces[at(selected->row, selected->col)] = nullptr;
+  apply_move(at(selected->row, selected->col), userAt(row, col));
+
+  delete selected;
+  selected = nullptr;
+}
 
+/// <summary>
+/// moves the piece on square from to square to (capturing whatever is there)
+/// </summary>
+void Chessboard::apply_move(int from, int to) {
+  TRACE_SPAN("apply_move");
+  if (recorder != nullptr) {
+    recorder->add_move({ from, to });
+  }
+  Chesspiece* previous = make_move({ from, to });
   // check for figure that was previously there, delete it if applicable
-  Chesspiece* previous = chesspieces[userAt(row, col)];
   if (previous != nullptr) {
     delete previous;
   }
+}
+
+bool Chessboard::play_move(const Move& move) {
+  for (const Move& allowed : get_legal_moves()) {
+    if (allowed.from == move.from && allowed.to == move.to) {
+      delete selected;
+      selected = nullptr;
+      apply_move(move.from, move.to);
+      return true;
+    }
+  }
+  return false;
+}
+
+/// <summary>
+/// moves a piece and keeps attack map and position key up to date; returns
+/// the captured piece (or nullptr), which the caller now owns
+/// </summary>
+Chesspiece* Chessboard::make_move(const Move& move) {
+  int from_row = move.from % size, from_col = move.from / size;
+  int to_row = move.to % size, to_col = move.to / size;
+  Chesspiece* moving = chesspieces[move.from];
+  Chesspiece* previous = chesspieces[move.to];
+  history.push_back({ hash, quiet_plies });
+  quiet_plies = previous != nullptr ? 0 : quiet_plies + 1;
+
+  if (previous != nullptr) {
+    hash ^= zobrist_piece(previous->get_letter(), previous->is_white(), move.to);
+    list_remove(move.to);
+    if (attacks != nullptr) {
+      // a capture is handled as removing the piece followed by a quiet move
+      attacks->remove_piece(*this, to_row, to_col);
+      put(move.to, nullptr);
+      attacks->open_square(*this, to_row, to_col);
+    }
+  }
+
+  // remove from current square
+  if (attacks != nullptr) {
+    attacks->remove_piece(*this, from_row, from_col);
+  }
+  list_move(move.from, move.to);
+  put(move.from, nullptr);
+  if (attacks != nullptr) {
+    attacks->open_square(*this, from_row, from_col);
+    attacks->close_square(*this, to_row, to_col);
+  }
 
   // place to new square
-  chesspieces[userAt(row, col)] = sel_cp;
+  put(move.to, moving);
+  if (attacks != nullptr) {
+    attacks->add_piece(*this, to_row, to_col);
+  }
 
+  hash ^= zobrist_piece(moving->get_letter(), moving->is_white(), move.from) ^
+    zobrist_piece(moving->get_letter(), moving->is_white(), move.to) ^ ZOBRIST_BLACK_TO_MOVE;
   whites_turn = !whites_turn;
+  legal_moves_valid = false;
+  return previous;
+}
+
+/// <summary>
+/// takes back a move done with make_move (the exact mirror of its steps)
+/// </summary>
+void Chessboard::unmake_move(const Move& move, Chesspiece* captured) {
+  int from_row = move.from % size, from_col = move.from / size;
+  int to_row = move.to % size, to_col = move.to / size;
+  Chesspiece* moving = chesspieces[move.to];
+
+  if (attacks != nullptr) {
+    attacks->remove_piece(*this, to_row, to_col);
+  }
+  list_move(move.to, move.from);
+  put(move.to, nullptr);
+  if (attacks != nullptr) {
+    attacks->open_square(*this, to_row, to_col);
+    attacks->close_square(*this, from_row, from_col);
+  }
+  put(move.from, moving);
+  if (attacks != nullptr) {
+    attacks->add_piece(*this, from_row, from_col);
+  }
+
+  if (captured != nullptr) {
+    if (attacks != nullptr) {
+      attacks->close_square(*this, to_row, to_col);
+    }
+    put(move.to, captured);
+    list_add(move.to);
+    if (attacks != nullptr) {
+      attacks->add_piece(*this, to_row, to_col);
+    }
+    hash ^= zobrist_piece(captured->get_letter(), captured->is_white(), move.to);
+  }
+  quiet_plies = history.back().quiet_plies;
+  history.pop_back();
+
+  hash ^= zobrist_piece(moving->get_letter(), moving->is_white(), move.from) ^
+    zobrist_piece(moving->get_letter(), moving->is_white(), move.to) ^ ZOBRIST_BLACK_TO_MOVE;
+  whites_turn = !whites_turn;
+  legal_moves_valid = false;
+}
+
+/// <summary>
+/// creates a figure from its letter (upper case: white); fairy pieces of the
+/// board win over the built-in classes
+/// </summary>
+static Chesspiece* create_piece(char letter, const std::vector<PieceDefinition>& fairy_pieces) {
+  bool is_white = std::isupper(static_cast<unsigned char>(letter)) != 0;
+  char symbol = static_cast<char>(std::toupper(static_cast<unsigned char>(letter)));
+  for (const PieceDefinition& definition : fairy_pieces) {
+    if (definition.symbol == symbol) {
+      return new FairyPiece{ symbol, is_white, definition.pattern };
+    }
+  }
+  switch (symbol) {
+  case 'K': return new King{ is_white };
+  case 'Q': return new Queen{ is_white };
+  case 'B': return new Bishop{ is_white };
+  case 'R': return new Rook{ is_white };
+  case 'N': return new Knight{ is_white };
+  case 'P': return new Pawn{ is_white };
+  case 'H': return new Hopper{ is_white };
+  case 'U': return new Quadrilateral{ is_white };
+  default: return nullptr;
+  }
+}
+
+std::string Chessboard::get_fen() const {
+  std::string fen;
+  for (int col = 0; col < size; col++) {
+    int empty = 0;
+    for (int row = 0; row < size; row++) {
+      const Chesspiece* cp = (*this)(row, col);
+      if (cp == nullptr) {
+        empty++;
+        continue;
+      }
+      if (empty > 0) {
+        fen += std::to_string(empty);
+        empty = 0;
+      }
+      char letter = cp->get_letter();
+      fen += cp->is_white() ? letter : static_cast<char>(std::tolower(letter));
+    }
+    if (empty > 0) {
+      fen += std::to_string(empty);
+    }
+    fen += col + 1 < size ? '/' : ' ';
+  }
+  fen += is_whites_turn() ? 'w' : 'b';
+  return fen;
+}
+
+/// <summary>
+/// replaces all figures by the position given in get_fen's format; the board
+/// stays unchanged if the text does not fit the board size
+/// </summary>
+bool Chessboard::set_fen(const std::string& fen) {
+  std::vector<Chesspiece*> squares(size * size, nullptr);
+  int row = 0, col = 0;
+  size_t i = 0;
+  bool valid = true;
+  for (; i < fen.size() && fen[i] != ' ' && valid; i++) {
+    char c = fen[i];
+    if (c == '/') {
+      valid = row == size;
+      row = 0;
+      col++;
+    }
+    else if (std::isdigit(static_cast<unsigned char>(c))) {
+      int empty = std::atoi(fen.c_str() + i);
+      while (i + 1 < fen.size() && std::isdigit(static_cast<unsigned char>(fen[i + 1]))) {
+        i++;
+      }
+      row += empty;
+      valid = row <= size;
+    }
+    else {
+      Chesspiece* cp = row < size && col < size ? create_piece(c, fairy_pieces) : nullptr;
+      valid = cp != nullptr;
+      if (valid) {
+        squares[at(row++, col)] = cp;
+      }
+    }
+  }
+  valid = valid && row == size && col == size - 1;
+  std::string turn = i < fen.size() ? fen.substr(i + 1) : "w";
+  if (!valid || (turn != "w" && turn != "b")) {
+    for (Chesspiece* cp : squares) {
+      delete cp;
+    }
+    return false;
+  }
+
+  for (int square = 0; square < size * size; square++) {
+    delete chesspieces[square];
+    chesspieces[square] = squares[square];
+  }
   delete selected;
   selected = nullptr;
+  whites_turn = turn == "w";
+  setup_position();
+  return true;
+}
+
+int fen_board_size(const std::string& fen) {
+  std::string ranks = fen.substr(0, fen.find(' '));
+  return static_cast<int>(std::count(ranks.begin(), ranks.end(), '/')) + 1;
+}
+
+std::string Chessboard::move_to_string(const Move& move) const {
+  return std::string(1, static_cast<char>('a' + move.from % size)) + std::to_string(size - move.from / size) +
+    '-' + static_cast<char>('a' + move.to % size) + std::to_string(size - move.to / size);
+}
+
+bool Chessboard::parse_move(const std::string& text, Move& move) const {
+  int squares[2];
+  size_t i = 0;
+  for (int s = 0; s < 2; s++) {
+    if (s == 1 && i < text.size() && text[i] == '-') {
+      i++;
+    }
+    if (i >= text.size() || !std::isalpha(static_cast<unsigned char>(text[i]))) {
+      return false;
+    }
+    int row = std::tolower(static_cast<unsigned char>(text[i++])) - 'a';
+    int rank = 0;
+    size_t digits = 0;
+    while (i < text.size() && std::isdigit(static_cast<unsigned char>(text[i])) && digits < 2) {
+      rank = rank * 10 + (text[i++] - '0');
+      digits++;
+    }
+    if (digits == 0 || !on_board(row, size - rank)) {
+      return false;
+    }
+    squares[s] = at(row, size - rank);
+  }
+  move = { squares[0], squares[1] };
+  return i == text.size();
+}
+
+int Chessboard::find_king(bool is_white) const {
+  for (int square : piece_squares[is_white]) {
+    if (chesspieces[square]->is_essential()) {
+      return square;
+    }
+  }
+  return -1;
+}
+
+/// <summary>
+/// adds the moves of the piece on row/col without looking at the own king
+/// (same semantics as Chesspiece::can_move)
+/// </summary>
+void Chessboard::add_pseudo_moves(int row, int col, std::vector<Move>& moves) const {
+  const Chesspiece* cp = (*this)(row, col);
+  bool is_white = cp->is_white();
+  const MovePattern& pattern = cp->get_pattern();
+  int from = at(row, col);
+
+  // every piece on the board was added on setup; should one be missing, its
+  // tables are built for this call only
+  const CompiledPattern* tables_of = tables.get(pattern);
+  CompiledPattern missing;
+  if (tables_of == nullptr) {
+    missing = tables.compile(pattern);
+    tables_of = &missing;
+  }
+  const CompiledPattern& compiled = *tables_of;
+  for (int i = compiled.leaps.first[from]; i < compiled.leaps.first[from + 1]; i++) {
+    const Chesspiece* target = chesspieces[compiled.leaps.targets[i]];
+    if (target == nullptr || target->is_white() != is_white) {
+      moves.push_back({ from, compiled.leaps.targets[i] });
+    }
+  }
+  for (int i = compiled.captures.first[from]; i < compiled.captures.first[from + 1]; i++) {
+    const Chesspiece* target = chesspieces[compiled.captures.targets[i]];
+    if (target != nullptr && target->is_white() != is_white) {
+      moves.push_back({ from, compiled.captures.targets[i] });
+    }
+  }
+  for (int i = compiled.quiet_leaps.first[from]; i < compiled.quiet_leaps.first[from + 1]; i++) {
+    if (chesspieces[compiled.quiet_leaps.targets[i]] == nullptr) {
+      moves.push_back({ from, compiled.quiet_leaps.targets[i] });
+    }
+  }
+  // rays stop on the border of the mailbox; squares run in parallel, as
+  // both are laid out column by column
+  int origin = mailbox_index[from];
+  for (const Offset& step : pattern.rides) {
+    int box_step = mailbox_step(step);
+    int square_step = step.col * size + step.row;
+    int box = origin + box_step, to = from + square_step;
+    while (mailbox[box] == Occupant::EMPTY) {
+      moves.push_back({ from, to });
+      box += box_step;
+      to += square_step;
+    }
+    if (mailbox[box] == enemy_of(is_white)) {
+      moves.push_back({ from, to });
+    }
+  }
+  if (pattern.pawn_push) {
+    int diff = is_white ? -1 : 1;
+    int initial_col = is_white ? size - 2 : 1;
+    if (mailbox[origin + diff * mailbox_width] == Occupant::EMPTY) {
+      moves.push_back({ from, from + diff * size });
+      if (col == initial_col && mailbox[origin + 2 * diff * mailbox_width] == Occupant::EMPTY) {
+        moves.push_back({ from, from + 2 * diff * size });
+      }
+    }
+  }
+}
+
+// squares king + k * step for k = 1..length (pin or check line, ends on the attacker)
+struct KingLine {
+  int attacker;
+  Offset step;
+  int length;
+};
+
+static bool on_king_line(const KingLine& line, int king_row, int king_col, int row, int col) {
+  int row_diff = row - king_row;
+  int col_diff = col - king_col;
+  int k = line.step.row != 0 ? row_diff / line.step.row : col_diff / line.step.col;
+  return k >= 1 && k <= line.length &&
+    row_diff == k * line.step.row && col_diff == k * line.step.col;
+}
+
+void Chessboard::generate_moves(std::vector<Move>& moves) const {
+  TRACE_SPAN("generate_moves");
+  moves.clear();
+  bool is_white = is_whites_turn();
+  int king = rules == RuleSet::CHECKMATE ? find_king(is_white) : -1;
+  if (king < 0) { // no king to protect: every move is fine
+    for (int square : piece_squares[is_white]) {
+      add_pseudo_moves(square % size, square / size, moves);
+    }
+    return;
+  }
+
+  int king_row = king % size, king_col = king / size;
+  int king_box = mailbox_index[king];
+  std::vector<KingLine> checkers;
+  std::vector<KingLine> pins;
+
+  // sliders: walk from the king against every ride direction
+  for (const Offset& ride : attacks->get_ray_directions()) {
+    Offset step = { -ride.row, -ride.col };
+    int box_step = mailbox_step(step);
+    int square_step = step.col * size + step.row;
+    int box = king_box + box_step;
+    int k = 1;
+    while (mailbox[box] == Occupant::EMPTY) {
+      box += box_step; k++;
+    }
+    if (mailbox[box] == Occupant::BORDER) {
+      continue;
+    }
+    int first_square = king + k * square_step;
+    const std::vector<Offset>& first_rides = chesspieces[first_square]->get_pattern().rides;
+    if (mailbox[box] == enemy_of(is_white)) {
+      if (std::find(first_rides.begin(), first_rides.end(), ride) != first_rides.end()) {
+        checkers.push_back({ first_square, step, k });
+      }
+      continue;
+    }
+    // own piece in between: look for a pinning slider behind it
+    box += box_step; k++;
+    while (mailbox[box] == Occupant::EMPTY) {
+      box += box_step; k++;
+    }
+    if (mailbox[box] != enemy_of(is_white)) {
+      continue;
+    }
+    const std::vector<Offset>& pinner_rides = chesspieces[king + k * square_step]->get_pattern().rides;
+    if (std::find(pinner_rides.begin(), pinner_rides.end(), ride) != pinner_rides.end()) {
+      pins.push_back({ first_square, step, k });
+    }
+  }
+  // leapers: look at the squares they would jump from
+  for (const Offset& leap : attacks->get_leap_offsets()) {
+    if (mailbox[king_box - mailbox_step(leap)] != enemy_of(is_white)) {
+      continue;
+    }
+    int square = king - (leap.col * size + leap.row);
+    const MovePattern& pattern = chesspieces[square]->get_pattern();
+    bool attacks_king =
+      std::find(pattern.leaps.begin(), pattern.leaps.end(), leap) != pattern.leaps.end() ||
+      std::find(pattern.captures.begin(), pattern.captures.end(), leap) != pattern.captures.end();
+    bool known = std::any_of(checkers.begin(), checkers.end(),
+      [&](const KingLine& line) { return line.attacker == square; });
+    if (attacks_king && !known) {
+      checkers.push_back({ square, { 0, 0 }, 0 });
+    }
+  }
+
+  // a checking slider keeps attacking through the square the king leaves
+  std::vector<KingLine> x_rays;
+  for (const KingLine& check : checkers) {
+    if (check.length == 0) {
+      continue;
+    }
+    Offset step = { -check.step.row, -check.step.col };
+    int box_step = mailbox_step(step);
+    int box = king_box + box_step;
+    int k = 1;
+    while (mailbox[box] == Occupant::EMPTY) {
+      box += box_step; k++;
+    }
+    x_rays.push_back({ check.attacker, step, mailbox[box] != Occupant::BORDER ? k : k - 1 });
+  }
+
+  for (int square : piece_squares[is_white]) {
+    int row = square % size, col = square / size;
+    size_t first_move = moves.size();
+    add_pseudo_moves(row, col, moves);
+    size_t kept = first_move;
+    for (size_t i = first_move; i < moves.size(); i++) {
+      int to_row = moves[i].to % size, to_col = moves[i].to / size;
+      bool legal = true;
+      if (moves[i].from == king) {
+        // the king must not step into an attack, not even along the line of
+        // a slider that is checking it right now
+        legal = attacks->count(to_row, to_col, !is_white) == 0;
+        for (const KingLine& x_ray : x_rays) {
+          if (on_king_line(x_ray, king_row, king_col, to_row, to_col)) {
+            legal = false;
+          }
+        }
+      }
+      else if (checkers.size() > 1) {
+        legal = false; // double check: only the king can move
+      }
+      else {
+        for (const KingLine& pin : pins) {
+          if (pin.attacker == moves[i].from) {
+            legal = on_king_line(pin, king_row, king_col, to_row, to_col);
+          }
+        }
+        if (legal && checkers.size() == 1) {
+          const KingLine& check = checkers.front();
+          legal = moves[i].to == check.attacker ||
+            (check.length > 0 && on_king_line(check, king_row, king_col, to_row, to_col));
+        }
+      }
+      if (legal) {
+        moves[kept++] = moves[i];
+      }
+    }
+    moves.resize(kept);
+  }
+}
+
+const std::vector<Move>& Chessboard::get_legal_moves() {
+  if (!legal_moves_valid) {
+    generate_moves(legal_moves);
+    legal_moves_valid = true;
+  }
+  return legal_moves;
+}
+
+/// <summary>
+/// checks if the piece on from_row/from_col may go to to_row/to_col under the
+/// current rules (all coordinates are internal ones)
+/// </summary>
+bool Chessboard::can_reach(int from_row, int from_col, int to_row, int to_col) {
+  const Chesspiece* cp = (*this)(from_row, from_col);
+  if (cp == nullptr) {
+    return false;
+  }
+  if (rules == RuleSet::CAPTURE_KING) {
+    return cp->can_move(from_row, from_col, to_row, to_col, *this);
+  }
+  int from = at(from_row, from_col);
+  int to = at(to_row, to_col);
+  for (const Move& move : get_legal_moves()) {
+    if (move.from == from && move.to == to) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Chessboard::in_check() const {
+  if (attacks == nullptr) {
+    return false;
+  }
+  int king = find_king(is_whites_turn());
+  return king >= 0 && attacks->count(king % size, king / size, !is_whites_turn()) > 0;
+}
+
+/// <summary>
+/// checks if the piece on row/col (internal coordinates) shields its own king
+/// from an enemy slider
+/// </summary>
+bool Chessboard::is_pinned(int row, int col) const {
+  const Chesspiece* cp = (*this)(row, col);
+  if (attacks == nullptr || cp == nullptr || cp->is_essential()) {
+    return false;
+  }
+  int king = find_king(cp->is_white());
+  if (king < 0) {
+    return false;
+  }
+  int piece_box = mailbox_index[at(row, col)];
+  for (const Offset& ride : attacks->get_ray_directions()) {
+    // is the piece on a free line from the king in this direction?
+    int box_step = mailbox_step(ride);
+    int box = mailbox_index[king] - box_step;
+    int k = 1;
+    while (mailbox[box] == Occupant::EMPTY) {
+      box -= box_step; k++;
+    }
+    if (box != piece_box) {
+      continue;
+    }
+    // and is there an enemy slider with that ride behind it?
+    box -= box_step; k++;
+    while (mailbox[box] == Occupant::EMPTY) {
+      box -= box_step; k++;
+    }
+    if (mailbox[box] != enemy_of(cp->is_white())) {
+      continue;
+    }
+    const std::vector<Offset>& rides = chesspieces[king - k * (ride.col * size + ride.row)]->get_pattern().rides;
+    if (std::find(rides.begin(), rides.end(), ride) != rides.end()) {
+      return true;
+    }
+  }
+  return false;
 }
 
 /// <summary>
 /// helper function to draw the header (A B C ...)
 /// </summary>
-static void draw_header(int size) {
-  cout << "    ";
+static void draw_header(std::ostream& out, int size) {
+  out << "    ";
   if (size > 9) { // if there is a number > 9 on the left, add some spacing
-    cout << ' ';
+    out << ' ';
   }
   for (short i = 'A'; i < 'A' + size; i++) {
 #ifdef DEBUGOUTPUT
-    cout << ' ' << i - 'A' << ' ';
+    out << ' ' << i - 'A' << ' ';
 #else
-    cout << ' ' << char(i) << ' ';
+    out << ' ' << char(i) << ' ';
 #endif  // DEBUG
   }
-  cout << endl;
+  out << endl;
 }
 
 /// <summary>
 /// helper function to draw a horizontal line (for top and bottom of board)
 /// </summary>
-static void draw_hr(int size) {
-  cout << "   ";
+static void draw_hr(std::ostream& out, int size) {
+  out << "   ";
   if (size > 9) { // if there is a number > 9 on the left, add some spacing
-    cout << ' ';
+    out << ' ';
   }
-  for (size_t i = 0; i < size; i++) {
-    cout << "---";
+  for (int i = 0; i < size; i++) {
+    out << "---";
   }
-  cout << "--" << endl;
+  out << "--" << endl;
 }
 
-void Chessboard::show() const {
-  draw_header(size);
-  draw_hr(size);
+void Chessboard::show(std::ostream& out) const {
+  TRACE_SPAN("show");
+  draw_header(out, size);
+  draw_hr(out, size);
   const Chesspiece* sel_cp = get_selected_chesspiece();
+  // squares the selected figure can reach, taken from the generated moves
+  // (show is const, so it leaves the cached moves alone)
+  std::vector<bool> reachable(size * size, false);
+  if (sel_cp != nullptr) {
+    int from = at(selected->row, selected->col);
+    std::vector<Move> moves;
+    generate_moves(moves);
+    for (const Move& move : moves) {
+      if (move.from == from) {
+        reachable[move.to] = true;
+      }
+    }
+  }
   // draw row number
-  for (size_t col = 0; col < get_size(); col++) {
+  for (int col = 0; col < get_size(); col++) {
     std::streamsize width = 1;
     if (size > 9) { // if there is a number > 9 on the left, add some spacing
       width = 2;
     }
 #ifdef DEBUGOUTPUT
-    cout << ' ' << std::setw(width) << col << ' ' << '|';
+    out << ' ' << std::setw(width) << col << ' ' << '|';
 #else
-    cout << ' ' << std::setw(width) << mapUserCol(col) << ' ' << '|';
+    out << ' ' << std::setw(width) << mapUserCol(col) << ' ' << '|';
 #endif  // DEBUG
     // draw row of board
-    for (size_t row = 0; row < get_size(); row++) {
+    for (int row = 0; row < get_size(); row++) {
       char opening_char = ' ';
       char closing_char = ' ';
       if (sel_cp != nullptr) {
@@ -306,22 +1070,22 @@ void Chessboard::show() const {
           opening_char = '(';
           closing_char = ')';
         }
-        else if (sel_cp->can_move(selected->row, selected->col, row, col, *this)) { // selectable squares get "highlighted"
+        else if (reachable[at(row, col)]) { // selectable squares get "highlighted"
           opening_char = '[';
           closing_char = ']';
         }
       }
       const Chesspiece* p = (*this)(row, col);
-      cout << opening_char;
+      out << opening_char;
       if (p != nullptr) {
-        cout << p->get_symbol(use_utf8);
+        out << p->get_symbol(use_utf8);
       }
       else {
-        cout << ".";
+        out << ".";
       }
-      cout << closing_char;
+      out << closing_char;
     }
-    cout << '|' << endl;
+    out << '|' << endl;
   }
-  draw_hr(size);
+  draw_hr(out, size);
 }
@@ -1,52 +1,210 @@
 #pragma once
 
-#include "Chesspiece.h";
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "AttackMap.h"
+#include "Chesspiece.h"
+#include "PatternTables.h"
+#include "PieceDefinition.h"
 
 class Chesspiece;
+class GameRecordWriter;
 
 // used for game_over state
-enum class GameState { PLAY_ON, BLACK_LOST, WHITE_LOST };
+enum class GameState {
+  PLAY_ON,
+  BLACK_LOST,
+  WHITE_LOST,
+  BLACK_CHECKMATED,
+  WHITE_CHECKMATED,
+  STALEMATE,
+  DRAW_BY_REPETITION, // the same position for the third time
+  DRAW_BY_NO_CAPTURE  // too many moves without a capture
+};
+
+constexpr int REPETITION_DRAW = 3;   // occurrences of a position that end the game
+constexpr int NO_CAPTURE_LIMIT = 100; // default: moves of both players without a capture
+
+constexpr int MIN_BOARD_SIZE = 8;
+constexpr int MAX_BOARD_SIZE = 26; // one letter per file
+
+// problems the library reports to its caller instead of printing them or
+// ending the process (error_message gives a text for the user)
+enum class ChessError {
+  NONE,
+  INVALID_SIZE,         // the board got the nearest allowed size instead
+  INVALID_START_SQUARE, // a start square of a fairy piece is off the board and was skipped
+  FILE_NOT_OPENED,      // a file could not be opened or created
+  NOT_A_GAME_RECORD,
+  DAMAGED_GAME_RECORD,
+  ILLEGAL_MOVE,         // a move was not legal in its position and was left out
+  NOT_AN_OPENING_BOOK
+};
+
+const char* error_message(ChessError error);
+
+
+// decides how a game ends
+enum class RuleSet {
+  CAPTURE_KING, // the king is captured like a normal figure
+  CHECKMATE     // no move may leave the own king in check
+};
+
+// what a square of the mailbox holds; the border around the board stops
+// every ray walk and leap without a range check
+enum class Occupant : uint8_t {
+  EMPTY,
+  WHITE,
+  BLACK,
+  BORDER
+};
 
 struct Position {
   int row;
   int col;
 };
 
+// a move between two squares (internal indices, see Chessboard::at)
+struct Move {
+  int from;
+  int to;
+};
+
+// a board is used by one thread at a time (even const queries fill the
+// move cache); copies share nothing, so every thread works on its own copy
 class Chessboard {
 private:
   int size;
   bool whites_turn = true;
   bool use_utf8;
+  RuleSet rules;
   Position* selected;
   Chesspiece** chesspieces;
+  std::vector<int> piece_squares[2]; // squares of the figures, [0] black and [1] white
+  std::vector<int> piece_index;      // place of a square in its piece list, -1 if empty
+  std::vector<PieceDefinition> fairy_pieces;
+  int pad;                        // border width of the mailbox: the longest step of any piece
+  int mailbox_width;              // size + 2 * pad
+  std::vector<Occupant> mailbox;  // colors of the squares, column by column like at()
+  std::vector<int> mailbox_index; // square -> index in the mailbox
+  PatternTables tables;
+  AttackMap* attacks; // only maintained with RuleSet::CHECKMATE
+  std::vector<Move> legal_moves; // cached for the current position
+  bool legal_moves_valid = false;
+  uint64_t hash = 0;
+  // position keys before every move (with the quiet_plies of then), for
+  // finding repetitions and taking moves back
+  struct HistoryEntry {
+    uint64_t hash;
+    int quiet_plies;
+  };
+  std::vector<HistoryEntry> history;
+  int quiet_plies = 0; // moves since the last capture (or the start of the position)
+  int no_capture_limit = NO_CAPTURE_LIMIT;
+  GameRecordWriter* recorder = nullptr; // not copied: copies are for searching
+  ChessError error = ChessError::NONE;
 
-  inline int mapUserRow(int row) const;
-  inline int mapUserCol(int col) const;
-  int at(int row, int col) const { return col * get_size() + row; }
+  int mapUserRow(int row) const;
+  int mapUserCol(int col) const;
   int userAt(int row, int col) const {
     return mapUserCol(col) * get_size() + mapUserRow(row);
   }
+  bool on_board(int row, int col) const {
+    return row >= 0 && row < size && col >= 0 && col < size;
+  }
   const Chesspiece* get_selected_chesspiece() const;
   void place_figures();
+  void place_fairy_pieces();
+  void setup_position();
+  void list_add(int square);
+  void list_remove(int square);
+  void list_move(int from, int to);
+  void put(int square, Chesspiece* cp);
+
+  int find_king(bool is_white) const;
+  void add_pseudo_moves(int row, int col, std::vector<Move>& moves) const;
+  const std::vector<Move>& get_legal_moves();
+  bool can_reach(int from_row, int from_col, int to_row, int to_col);
+  void apply_move(int from, int to);
 
 public:
   Chessboard() = delete;
-  Chessboard(bool use_utf8 = false, int size = 8);
+  Chessboard(bool use_utf8 = false, int size = 8, RuleSet rules = RuleSet::CAPTURE_KING,
+    const std::vector<PieceDefinition>& fairy_pieces = {});
+  Chessboard(const Chessboard& other);
+  Chessboard& operator=(const Chessboard& other) = delete;
   ~Chessboard();
+  // the first problem of the setup, ChessError::NONE for a board as requested
+  ChessError get_error() const { return error; }
   bool is_whites_turn() const { return whites_turn; };
-  GameState is_game_over() const;
+  // not const: is_game_over and the selection checks keep the legal moves of
+  // the position in the board until the next move
+  GameState is_game_over();
   int get_size() const { return size; }
+  RuleSet get_rules() const { return rules; }
+  const PatternTables& get_tables() const { return tables; }
+  const std::vector<PieceDefinition>& get_fairy_pieces() const { return fairy_pieces; }
+  uint64_t get_hash() const { return hash; }
+  // how often the current position was on the board before; only the
+  // positions since the last capture are looked at, no earlier one can return
+  int repetitions() const;
+  int get_quiet_plies() const { return quiet_plies; }
+  // moves of both players without a capture until the game is drawn, 0: no limit
+  void set_no_capture_limit(int plies) { no_capture_limit = plies; }
+  bool no_capture_limit_reached() const { return no_capture_limit > 0 && quiet_plies >= no_capture_limit; }
+  // one of the draws of is_game_over (without looking for mate or a lost king)
+  bool is_draw() const { return no_capture_limit_reached() || repetitions() >= REPETITION_DRAW - 1; }
+  int at(int row, int col) const { return col * get_size() + row; }
   const Chesspiece* operator()(int row, int col) const;
+  const Chesspiece* piece_at(int square) const { return chesspieces[square]; }
+  // squares of all figures of one color (in no particular order)
+  const std::vector<int>& get_piece_squares(bool is_white) const { return piece_squares[is_white]; }
+  // padded board for walking rays: a step of step.row/step.col is
+  // step.col * get_mailbox_width() + step.row in the mailbox
+  const Occupant* get_mailbox() const { return mailbox.data(); }
+  int get_mailbox_width() const { return mailbox_width; }
+  int to_mailbox(int square) const { return mailbox_index[square]; }
+  int mailbox_step(const Offset& step) const { return step.col * mailbox_width + step.row; }
 
   bool can_pass_over(int row, int col) const;
   bool can_land_on(int row, int col, bool is_white) const;
   bool can_capture_on(int row, int col, bool is_white) const;
 
-  bool can_select_piece(int row, int col) const;
-  bool can_move_selection_to(int row, int col) const;
-  bool can_move(int from_row, int from_col, int to_row, int to_col) const;
+  bool can_select_piece(int row, int col);
+  bool can_move_selection_to(int row, int col);
+  bool can_move(int from_row, int from_col, int to_row, int to_col);
+
+  // RuleSet::CHECKMATE only (always false when kings are simply captured)
+  bool in_check() const;
+  bool is_pinned(int row, int col) const;
+  // all moves of the player on turn (legal ones with RuleSet::CHECKMATE)
+  void generate_moves(std::vector<Move>& moves) const;
+
+  // plays the move if it is allowed for the player on turn
+  bool play_move(const Move& move);
+  // every move played from now on (not the ones of make_move) goes to the record
+  void set_recorder(GameRecordWriter* writer) { recorder = writer; }
+
+  // for searches: the captured piece stays alive until the move is taken back
+  Chesspiece* make_move(const Move& move);
+  void unmake_move(const Move& move, Chesspiece* captured);
+
+  // positions as text: ranks from the top, digits for empty squares, upper case
+  // for white, then 'w' or 'b' for the player on turn (eg ".../RNBQKBNR w")
+  std::string get_fen() const;
+  bool set_fen(const std::string& fen);
+  // moves as text in the format "e2-e4" (the '-' is optional when parsing)
+  std::string move_to_string(const Move& move) const;
+  bool parse_move(const std::string& text, Move& move) const;
 
   void select_piece(int row, int col);
   void move_selection_to(int row, int col);
-  void show() const;
+  // draws the board as text (the selected figure and its targets marked)
+  void show(std::ostream& out) const;
 };
+
+// board size of a position in get_fen's format (the number of ranks)
+int fen_board_size(const std::string& fen);
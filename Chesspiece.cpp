@@ -2,7 +2,7 @@
 
 #include <iostream>
 
-#define DEBUG(X) cout << std::boolalpha << (#X) << " = " << (X) << endl
+#include "Stats.h"
 
 // if we want to display unicode characters, we need a mapping
 std::map<std::string, const char*> utf8_symbol_map = {
@@ -74,9 +74,12 @@ static bool knight_can_move(int from_row, int from_col, int to_row, int to_col,
 static bool hopper_can_move(int from_row, int from_col, int to_row, int to_col,
   bool is_white, const Chessboard& cb);
 
+static bool pattern_can_move(int from_row, int from_col, int to_row, int to_col,
+  bool is_white, const MovePattern& pattern, const Chessboard& cb);
+
 #pragma endregion static_function_declarations
 
-const char* Chesspiece::get_symbol(bool use_utf8) const {
+std::string Chesspiece::get_symbol(bool use_utf8) const {
   // a special implementation to support utf8 characters
   if (use_utf8) {
     std::string symbol_color_id = get_color() + std::string(1, symbol);
@@ -87,14 +90,12 @@ const char* Chesspiece::get_symbol(bool use_utf8) const {
   }
 
   // if no utf8 char found or if it is disabled -> show default ascii one
-  char* symbol_arr = new char[2];
-  symbol_arr[0] = is_white() ? symbol : std::tolower(symbol);
-  symbol_arr[1] = '\0';
-  return symbol_arr;
+  return std::string(1, is_white() ? symbol : static_cast<char>(std::tolower(symbol)));
 }
 
 bool King::can_move(int from_row, int from_col, int to_row, int to_col,
   const Chessboard& cb) const {
+  COUNT_STAT(Counter::CAN_MOVE_KING);
   /*
    * One hop in all directions
    * [.][.][.]
@@ -119,6 +120,7 @@ bool King::can_move(int from_row, int from_col, int to_row, int to_col,
 
 bool Queen::can_move(int from_row, int from_col, int to_row, int to_col,
   const Chessboard& cb) const {
+  COUNT_STAT(Counter::CAN_MOVE_QUEEN);
   /*
    * All directions
    * [\][|][/]
@@ -132,6 +134,7 @@ bool Queen::can_move(int from_row, int from_col, int to_row, int to_col,
 
 bool Bishop::can_move(int from_row, int from_col, int to_row, int to_col,
   const Chessboard& cb) const {
+  COUNT_STAT(Counter::CAN_MOVE_BISHOP);
   /*
    * Only diagonal
    * [\] . [/]
@@ -143,6 +146,7 @@ bool Bishop::can_move(int from_row, int from_col, int to_row, int to_col,
 
 bool Rook::can_move(int from_row, int from_col, int to_row, int to_col,
   const Chessboard& cb) const {
+  COUNT_STAT(Counter::CAN_MOVE_ROOK);
   /*
    * Horizontal and diagonal
    *  . [|] .
@@ -154,6 +158,7 @@ bool Rook::can_move(int from_row, int from_col, int to_row, int to_col,
 
 bool Knight::can_move(int from_row, int from_col, int to_row, int to_col,
   const Chessboard& cb) const {
+  COUNT_STAT(Counter::CAN_MOVE_KNIGHT);
   /*
    * Only in L(2x1) formations
    *  . [.] . [.] .
@@ -167,6 +172,7 @@ bool Knight::can_move(int from_row, int from_col, int to_row, int to_col,
 
 bool Pawn::can_move(int from_row, int from_col, int to_row, int to_col,
   const Chessboard& cb) const {
+  COUNT_STAT(Counter::CAN_MOVE_PAWN);
   /*
    * Only forward; when at its initial position it can move two fields
    * Special care needs the capture part of the Pawn (as he can't capture in move direction)
@@ -207,6 +213,7 @@ bool Pawn::can_move(int from_row, int from_col, int to_row, int to_col,
 
 bool Hopper::can_move(int from_row, int from_col, int to_row, int to_col, const Chessboard& cb) const
 {
+  COUNT_STAT(Counter::CAN_MOVE_HOPPER);
   /*
    * Two hops horizontal or vertical
    *  .  . [.] .  .
@@ -220,6 +227,7 @@ bool Hopper::can_move(int from_row, int from_col, int to_row, int to_col, const
 
 bool Quadrilateral::can_move(int from_row, int from_col, int to_row, int to_col, const Chessboard& cb) const
 {
+  COUNT_STAT(Counter::CAN_MOVE_QUADRILATERAL);
   /*
    * Hop like the king, but one wider
    *  . [.][.][.] .
@@ -233,6 +241,76 @@ bool Quadrilateral::can_move(int from_row, int from_col, int to_row, int to_col,
     hopper_can_move(from_row, from_col, to_row, to_col, is_white(), cb);
 }
 
+/* --------- DATA-DRIVEN CHESSPIECES --------- */
+
+bool FairyPiece::can_move(int from_row, int from_col, int to_row, int to_col, const Chessboard& cb) const
+{
+  COUNT_STAT(Counter::CAN_MOVE_FAIRY);
+  /*
+   * Whatever the definition says, eg "ND" is the Quadrilateral
+   */
+  return pattern_can_move(from_row, from_col, to_row, to_col, is_white(), *pattern, cb);
+}
+
+#pragma region move_patterns
+
+static const std::vector<Offset> orthogonal_steps = { {1, 0}, {-1, 0}, {0, 1}, {0, -1} };
+static const std::vector<Offset> diagonal_steps = { {1, 1}, {1, -1}, {-1, 1}, {-1, -1} };
+static const std::vector<Offset> all_steps = { {1, 0}, {-1, 0}, {0, 1}, {0, -1},
+                                               {1, 1}, {1, -1}, {-1, 1}, {-1, -1} };
+static const std::vector<Offset> knight_leaps = { {2, 1}, {2, -1}, {-2, 1}, {-2, -1},
+                                                  {1, 2}, {1, -2}, {-1, 2}, {-1, -2} };
+static const std::vector<Offset> hopper_leaps = { {2, 0}, {-2, 0}, {0, 2}, {0, -2} };
+
+static std::vector<Offset> combine(const std::vector<Offset>& first, const std::vector<Offset>& second) {
+  std::vector<Offset> combined = first;
+  combined.insert(combined.end(), second.begin(), second.end());
+  return combined;
+}
+
+const MovePattern& King::get_pattern() const {
+  static const MovePattern pattern = { all_steps, {}, {}, {}, false };
+  return pattern;
+}
+
+const MovePattern& Queen::get_pattern() const {
+  static const MovePattern pattern = { {}, all_steps, {}, {}, false };
+  return pattern;
+}
+
+const MovePattern& Bishop::get_pattern() const {
+  static const MovePattern pattern = { {}, diagonal_steps, {}, {}, false };
+  return pattern;
+}
+
+const MovePattern& Rook::get_pattern() const {
+  static const MovePattern pattern = { {}, orthogonal_steps, {}, {}, false };
+  return pattern;
+}
+
+const MovePattern& Knight::get_pattern() const {
+  static const MovePattern pattern = { knight_leaps, {}, {}, {}, false };
+  return pattern;
+}
+
+const MovePattern& Pawn::get_pattern() const {
+  // same as can_move: pawns capture on every diagonal neighbour
+  static const MovePattern pattern = { {}, {}, diagonal_steps, {}, true };
+  return pattern;
+}
+
+const MovePattern& Hopper::get_pattern() const {
+  static const MovePattern pattern = { hopper_leaps, {}, {}, {}, false };
+  return pattern;
+}
+
+const MovePattern& Quadrilateral::get_pattern() const {
+  static const MovePattern pattern = { combine(knight_leaps, hopper_leaps), {}, {}, {}, false };
+  return pattern;
+}
+
+#pragma endregion move_patterns
+
 #pragma region static_function_definitions
 
 static void swap(int& first, int& second) {
@@ -343,4 +421,39 @@ static bool hopper_can_move(int from_row, int from_col, int to_row, int to_col,
   return false;
 }
 
+static bool pattern_can_move(int from_row, int from_col, int to_row, int to_col,
+  bool is_white, const MovePattern& pattern, const Chessboard& cb) {
+  Offset diff = { to_row - from_row, to_col - from_col };
+  for (const Offset& leap : pattern.leaps) {
+    if (leap == diff) {
+      return cb.can_land_on(to_row, to_col, is_white);
+    }
+  }
+  for (const Offset& leap : pattern.captures) {
+    if (leap == diff && cb.can_capture_on(to_row, to_col, is_white)) {
+      return true;
+    }
+  }
+  for (const Offset& leap : pattern.quiet_leaps) {
+    if (leap == diff && cb.can_pass_over(to_row, to_col)) {
+      return true;
+    }
+  }
+  for (const Offset& step : pattern.rides) {
+    // the difference must be a positive multiple of the step
+    int k = step.row != 0 ? diff.row / step.row : diff.col / step.col;
+    if (k < 1 || diff.row != k * step.row || diff.col != k * step.col) {
+      continue;
+    }
+    bool free_way = true;
+    for (int i = 1; i < k && free_way; i++) {
+      free_way = cb.can_pass_over(from_row + i * step.row, from_col + i * step.col);
+    }
+    if (free_way && cb.can_land_on(to_row, to_col, is_white)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 #pragma endregion static_function_definitions
@@ -2,8 +2,11 @@
 
 #include <locale>  // for tolower
 #include <map>
+#include <memory>
+#include <string>
 
 #include "Chessboard.h"
+#include "MovePattern.h"
 
 class Chessboard;
 
@@ -16,13 +19,16 @@ class Chesspiece {
   Chesspiece(char symbol, bool is_white) : symbol(symbol), white(is_white) {}
   virtual ~Chesspiece() { /* nothing to do here */ }
 
-  const char *get_symbol(bool use_utf8) const;
+  std::string get_symbol(bool use_utf8) const;
   char get_color() const { return is_white() ? 'W' : 'B'; }
+  char get_letter() const { return symbol; }
   bool is_white() const { return white; }
   virtual bool is_essential() const { return false; }
   virtual bool can_move(int from_row, int from_col,  //
                         int to_row, int to_col,      //
                         const Chessboard &cb) const = 0;
+  virtual const MovePattern &get_pattern() const = 0;
+  virtual Chesspiece *clone() const = 0;
 };
 
 class King : public Chesspiece {
@@ -34,6 +40,8 @@ class King : public Chesspiece {
   virtual bool can_move(int from_row, int from_col,  //
                         int to_row, int to_col,      //
                         const Chessboard &cb) const override;
+  virtual const MovePattern &get_pattern() const override;
+  virtual Chesspiece *clone() const override { return new King(*this); }
 };
 
 class Queen : public Chesspiece {
@@ -43,6 +51,8 @@ class Queen : public Chesspiece {
   virtual bool can_move(int from_row, int from_col,  //
                         int to_row, int to_col,      //
                         const Chessboard &cb) const override;
+  virtual const MovePattern &get_pattern() const override;
+  virtual Chesspiece *clone() const override { return new Queen(*this); }
 };
 
 class Bishop : public Chesspiece {
@@ -52,6 +62,8 @@ class Bishop : public Chesspiece {
   virtual bool can_move(int from_row, int from_col,  //
                         int to_row, int to_col,      //
                         const Chessboard &cb) const override;
+  virtual const MovePattern &get_pattern() const override;
+  virtual Chesspiece *clone() const override { return new Bishop(*this); }
 };
 
 class Rook : public Chesspiece {
@@ -61,6 +73,8 @@ class Rook : public Chesspiece {
   virtual bool can_move(int from_row, int from_col,  //
                         int to_row, int to_col,      //
                         const Chessboard &cb) const override;
+  virtual const MovePattern &get_pattern() const override;
+  virtual Chesspiece *clone() const override { return new Rook(*this); }
 };
 
 class Knight : public Chesspiece {
@@ -70,6 +84,8 @@ class Knight : public Chesspiece {
   virtual bool can_move(int from_row, int from_col,  //
                         int to_row, int to_col,      //
                         const Chessboard &cb) const override;
+  virtual const MovePattern &get_pattern() const override;
+  virtual Chesspiece *clone() const override { return new Knight(*this); }
 };
 
 class Pawn : public Chesspiece {
@@ -79,6 +95,8 @@ public:
   virtual bool can_move(int from_row, int from_col,  //
                         int to_row, int to_col,      //
                         const Chessboard& cb) const override;
+  virtual const MovePattern &get_pattern() const override;
+  virtual Chesspiece *clone() const override { return new Pawn(*this); }
 };
 
 /* --------- SPECIAL CHESSPIECES --------- */
@@ -89,6 +107,8 @@ public:
   virtual bool can_move(int from_row, int from_col,  //
                         int to_row, int to_col,      //
                         const Chessboard& cb) const override;
+  virtual const MovePattern &get_pattern() const override;
+  virtual Chesspiece *clone() const override { return new Hopper(*this); }
 };
 
 class Quadrilateral : public Chesspiece {
@@ -98,4 +118,22 @@ public:
   virtual bool can_move(int from_row, int from_col,  //
                         int to_row, int to_col,      //
                         const Chessboard& cb) const override;
+  virtual const MovePattern &get_pattern() const override;
+  virtual Chesspiece *clone() const override { return new Quadrilateral(*this); }
+};
+
+/* --------- DATA-DRIVEN CHESSPIECES --------- */
+class FairyPiece : public Chesspiece {
+private:
+  std::shared_ptr<const MovePattern> pattern;
+
+public:
+  FairyPiece(char symbol, bool is_white, std::shared_ptr<const MovePattern> pattern)
+    : Chesspiece(symbol, is_white), pattern(pattern) {}
+
+  virtual bool can_move(int from_row, int from_col,  //
+                        int to_row, int to_col,      //
+                        const Chessboard& cb) const override;
+  virtual const MovePattern &get_pattern() const override { return *pattern; }
+  virtual Chesspiece *clone() const override { return new FairyPiece(*this); }
 };
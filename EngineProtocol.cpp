@@ -0,0 +1,245 @@
+#include "EngineProtocol.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+EngineProtocol::EngineProtocol(std::istream& in, std::ostream& out)
+  : in(in), out(out) {
+  new_board();
+}
+
+EngineProtocol::~EngineProtocol() {
+  wait_for_search();
+}
+
+void EngineProtocol::send(const std::string& line) {
+  // the search thread reports while the input thread answers commands
+  std::lock_guard<std::mutex> lock(out_mutex);
+  out << line << std::endl;
+}
+
+void EngineProtocol::new_board() {
+  board.reset(new Chessboard(false, size, rules, fairy_pieces));
+  if (board->get_error() != ChessError::NONE) {
+    send(std::string("info string ") + error_message(board->get_error()));
+  }
+}
+
+/// <summary>
+/// stops a running search and waits until it has sent its bestmove
+/// </summary>
+void EngineProtocol::wait_for_search() {
+  if (worker.joinable()) {
+    search.stop();
+    mcts.stop();
+    worker.join();
+  }
+}
+
+void EngineProtocol::set_option(std::istringstream& command) {
+  std::string token, name, value;
+  command >> token; // "name"
+  while (command >> token && token != "value") {
+    name += (name.empty() ? "" : " ") + token;
+  }
+  std::getline(command >> std::ws, value);
+
+  if (name == "Size") {
+    int new_size = std::atoi(value.c_str());
+    if (new_size < MIN_BOARD_SIZE || new_size > MAX_BOARD_SIZE) {
+      send("info string Size must be between 8 and 26");
+      return;
+    }
+    size = new_size;
+  }
+  else if (name == "Rules" && (value == "capture" || value == "checkmate")) {
+    rules = value == "checkmate" ? RuleSet::CHECKMATE : RuleSet::CAPTURE_KING;
+  }
+  else if (name == "Player" && (value == "alphabeta" || value == "mcts")) {
+    use_mcts = value == "mcts";
+    return; // the player does not change the position
+  }
+  else if (name == "Threads") {
+    mcts.set_threads(std::min(std::max(std::atoi(value.c_str()), 1), 256));
+    return;
+  }
+  else if (name == "Exploration") {
+    mcts.set_exploration(std::atof(value.c_str()));
+    return;
+  }
+  else if (name == "Book") {
+    if (value == "none") {
+      book.close();
+    }
+    else if (!book.open(value)) {
+      send("info string could not load the book " + value + ": " + error_message(book.get_error()));
+    }
+    return;
+  }
+  else if (name == "Pieces") {
+    std::vector<PieceDefinition> definitions;
+    std::string error;
+    if (value != "none" && !load_piece_definitions(value, definitions, error)) {
+      send("info string " + error);
+      return;
+    }
+    fairy_pieces = definitions;
+  }
+  else {
+    send("info string unknown option " + name);
+    return;
+  }
+  new_board();
+}
+
+void EngineProtocol::set_position(std::istringstream& command) {
+  std::string kind;
+  command >> kind;
+  std::unique_ptr<Chessboard> position;
+  if (kind == "startpos") {
+    position.reset(new Chessboard(false, size, rules, fairy_pieces));
+  }
+  else if (kind == "fen") {
+    std::string ranks, turn;
+    command >> ranks >> turn;
+    // the number of ranks decides the board size
+    int fen_size = fen_board_size(ranks);
+    if (fen_size < MIN_BOARD_SIZE || fen_size > MAX_BOARD_SIZE) {
+      send("info string unsupported board size in fen");
+      return;
+    }
+    position.reset(new Chessboard(false, fen_size, rules, fairy_pieces));
+    if (!position->set_fen(ranks + ' ' + turn)) {
+      send("info string invalid fen");
+      return;
+    }
+  }
+  else {
+    send("info string position needs startpos or fen");
+    return;
+  }
+
+  std::string token;
+  command >> token; // "moves"
+  while (command >> token) {
+    Move move;
+    // all moves or none: the engine must not search a position that was not sent
+    if (!position->parse_move(token, move) || !position->play_move(move)) {
+      send("info string illegal move " + token + ", the position is not changed");
+      return;
+    }
+  }
+  board = std::move(position);
+}
+
+void EngineProtocol::go(std::istringstream& command) {
+  SearchLimits limits;
+  bool infinite = false;
+  std::string token;
+  while (command >> token) {
+    if (token == "depth" && command >> limits.depth) {
+      limits.depth = std::min(std::max(limits.depth, 1), MAX_PLY - 1);
+    }
+    else if (token == "nodes") {
+      command >> limits.nodes;
+    }
+    else if (token == "movetime") {
+      command >> limits.move_time;
+    }
+    else if (token == "wtime" || token == "btime") {
+      int64_t time = 0;
+      command >> time;
+      if ((token == "wtime") == board->is_whites_turn()) {
+        limits.clock = std::max<int64_t>(time, 1);
+      }
+    }
+    else if (token == "winc" || token == "binc") {
+      int64_t increment = 0;
+      command >> increment;
+      if ((token == "winc") == board->is_whites_turn()) {
+        limits.increment = increment;
+      }
+    }
+    else if (token == "movestogo") {
+      command >> limits.moves_to_go;
+    }
+    else if (token == "infinite") { // the default limits: search until stop
+      infinite = true;
+    }
+  }
+
+  Move book_move;
+  if (!infinite && book.pick_best(*board, book_move)) {
+    send("info string book move");
+    send("bestmove " + board->move_to_string(book_move));
+    return;
+  }
+
+  // the search works on its own copy, the input thread keeps answering
+  std::unique_ptr<Chessboard> position(new Chessboard(*board));
+  search.clear_stop();
+  mcts.clear_stop();
+  worker = std::thread([this, limits](std::unique_ptr<Chessboard> position) {
+    SearchReport report = [&](const SearchResult& iteration) {
+      int64_t nps = iteration.time > 0 ? iteration.nodes * 1000 / iteration.time : 0;
+      send("info depth " + std::to_string(iteration.depth) + " score " + score_to_string(iteration.score) +
+        " nodes " + std::to_string(iteration.nodes) + " nps " + std::to_string(nps) +
+        " time " + std::to_string(iteration.time) + " pv " + position->move_to_string(iteration.best_move));
+    };
+    SearchResult result = use_mcts ? mcts.search(*position, limits, report) : search.run(*position, limits, report);
+    send("bestmove " + (result.has_move ? position->move_to_string(result.best_move) : "(none)"));
+  }, std::move(position));
+}
+
+void EngineProtocol::run() {
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream command(line);
+    std::string name;
+    command >> name;
+    if (name == "uci") {
+      send("id name CPP_Chess");
+      send("option name Size type spin default 8 min 8 max 26");
+      send("option name Rules type combo default capture var capture var checkmate");
+      send("option name Pieces type string default none");
+      send("option name Player type combo default alphabeta var alphabeta var mcts");
+      send("option name Threads type spin default 1 min 1 max 256");
+      send("option name Exploration type string default 1.4");
+      send("option name Book type string default none");
+      send("uciok");
+    }
+    else if (name == "isready") {
+      send("readyok");
+    }
+    else if (name == "ucinewgame") {
+      wait_for_search();
+      search.clear();
+      mcts.clear();
+    }
+    else if (name == "setoption") {
+      wait_for_search();
+      set_option(command);
+    }
+    else if (name == "position") {
+      wait_for_search();
+      set_position(command);
+    }
+    else if (name == "go") {
+      wait_for_search();
+      go(command);
+    }
+    else if (name == "stop") {
+      wait_for_search();
+    }
+    else if (name == "d") {
+      send("info string fen " + board->get_fen());
+    }
+    else if (name == "quit") {
+      break;
+    }
+    else if (!name.empty()) {
+      send("info string unknown command " + name);
+    }
+  }
+  wait_for_search();
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Chessboard.h"
+#include "Mcts.h"
+#include "OpeningBook.h"
+#include "Search.h"
+
+/// <summary>
+/// headless UCI-like line protocol on stdin/stdout. The search runs on its
+/// own thread, so "stop" and "isready" are answered while it is thinking.
+///
+///   uci | isready | ucinewgame | quit | d
+///   setoption name Size|Rules|Pieces value &lt;8-26 | capture|checkmate | file&gt;
+///   setoption name Player|Threads|Exploration value &lt;alphabeta|mcts | n | c&gt;
+///   setoption name Book value &lt;file|none&gt;
+///   position startpos|fen &lt;ranks&gt; &lt;w|b&gt; [moves e2-e4 ...]
+///   go [depth n] [nodes n] [movetime ms] [wtime ms btime ms winc ms binc ms movestogo n] [infinite]
+///   stop
+/// </summary>
+class EngineProtocol {
+private:
+  std::istream& in;
+  std::ostream& out;
+  std::mutex out_mutex;
+
+  int size = 8;
+  RuleSet rules = RuleSet::CAPTURE_KING;
+  std::vector<PieceDefinition> fairy_pieces;
+  std::unique_ptr<Chessboard> board;
+
+  Search search;
+  MctsPlayer mcts;
+  bool use_mcts = false;
+  OpeningBook book; // book moves are played without searching (not with "go infinite")
+  std::thread worker;
+
+  void send(const std::string& line);
+  void new_board();
+  void wait_for_search();
+  void set_option(std::istringstream& command);
+  void set_position(std::istringstream& command);
+  void go(std::istringstream& command);
+
+public:
+  EngineProtocol(std::istream& in, std::ostream& out);
+  ~EngineProtocol();
+
+  // handles commands until "quit" or the end of the input
+  void run();
+};
@@ -0,0 +1,429 @@
+#include "GameRecord.h"
+
+#include <algorithm>
+
+constexpr char RECORD_MAGIC[] = "CGR1";
+constexpr char BLOCK_MAGIC[] = "CGRB";
+constexpr char INDEX_MAGIC[] = "CGRI";
+constexpr int BLOCK_HEADER_BYTES = 4 + 4 + 4; // magic, game count, byte count
+constexpr size_t BLOCK_BYTES = 1 << 16;
+constexpr int RESULT_BITS = 4;
+constexpr int TRAILER_BYTES = 4 + 8 + 4; // block count, index offset, magic
+constexpr int INDEX_ENTRY_BYTES = 8 + 4;  // block offset, first game
+
+// number of bits needed to write the numbers 0..value
+static int bit_width(uint64_t value) {
+  int bits = 0;
+  while (value >> bits) {
+    bits++;
+  }
+  return bits;
+}
+
+#pragma region file_helpers
+
+// all numbers are written little endian, independent of the machine
+static void write_number(std::ostream& out, uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; i++) {
+    out.put(static_cast<char>((value >> (8 * i)) & 0xFF));
+  }
+}
+
+static bool read_number(std::istream& in, uint64_t& value, int bytes) {
+  value = 0;
+  for (int i = 0; i < bytes; i++) {
+    int byte = in.get();
+    if (byte == EOF) {
+      return false;
+    }
+    value |= static_cast<uint64_t>(byte) << (8 * i);
+  }
+  return true;
+}
+
+static void write_text(std::ostream& out, const std::string& text) {
+  write_number(out, std::min<size_t>(text.size(), 255), 1);
+  out.write(text.data(), std::min<size_t>(text.size(), 255));
+}
+
+static bool read_text(std::istream& in, std::string& text) {
+  uint64_t length;
+  if (!read_number(in, length, 1)) {
+    return false;
+  }
+  text.resize(static_cast<size_t>(length));
+  return length == 0 || in.read(&text[0], length);
+}
+
+// reads up to 56 bits starting at bit position; false if they would go past
+// end (the bits of the block, which is followed by 8 bytes of padding)
+static bool read_bits(const std::vector<uint8_t>& data, uint64_t end, uint64_t& position, int bits,
+  uint64_t& value) {
+  if (position > end || static_cast<uint64_t>(bits) > end - position) {
+    return false;
+  }
+  size_t byte = static_cast<size_t>(position / 8);
+  uint64_t word = 0;
+  for (int i = 0; i < 8; i++) {
+    word |= static_cast<uint64_t>(data[byte + i]) << (8 * i);
+  }
+  value = (word >> (position % 8)) & ((static_cast<uint64_t>(1) << bits) - 1);
+  position += bits;
+  return true;
+}
+
+// Elias gamma code: value >= 1 in 2 * bit_width(value) - 1 bits
+static bool read_gamma(const std::vector<uint8_t>& data, uint64_t end, uint64_t& position, uint64_t& value) {
+  int zeros = 0;
+  uint64_t bit = 0;
+  while (true) {
+    if (!read_bits(data, end, position, 1, bit)) {
+      return false;
+    }
+    if (bit == 1) {
+      break;
+    }
+    if (++zeros > 48) {
+      return false;
+    }
+  }
+  if (!read_bits(data, end, position, zeros, value)) {
+    return false;
+  }
+  value |= static_cast<uint64_t>(1) << zeros;
+  return true;
+}
+
+#pragma endregion file_helpers
+
+GameRecordWriter::GameRecordWriter(const std::string& path, int size, RuleSet rules,
+  const std::vector<PieceDefinition>& fairy_pieces)
+  : file(path, std::ios::binary),
+  start(new Chessboard(false, size, rules, fairy_pieces)) {
+  if (!file) {
+    error = ChessError::FILE_NOT_OPENED;
+    return;
+  }
+  file.write(RECORD_MAGIC, 4);
+  write_number(file, size, 1);
+  write_number(file, static_cast<uint64_t>(rules), 1);
+  write_number(file, fairy_pieces.size(), 1);
+  for (const PieceDefinition& definition : fairy_pieces) {
+    write_number(file, static_cast<unsigned char>(definition.symbol), 1);
+    write_text(file, definition.betza);
+    write_number(file, definition.start_squares.size(), 1);
+    for (const std::string& square : definition.start_squares) {
+      write_text(file, square);
+    }
+  }
+}
+
+GameRecordWriter::~GameRecordWriter() {
+  close();
+}
+
+void GameRecordWriter::write_bits(uint64_t value, int bits) {
+  while (bits > 0) {
+    int used = static_cast<int>(block_bits % 8);
+    if (used == 0) {
+      block.push_back(0);
+    }
+    int taken = std::min(bits, 8 - used);
+    block.back() |= static_cast<uint8_t>((value & ((1u << taken) - 1)) << used);
+    value >>= taken;
+    bits -= taken;
+    block_bits += taken;
+  }
+}
+
+void GameRecordWriter::write_gamma(uint64_t value) {
+  int bits = bit_width(value);
+  write_bits(0, bits - 1);
+  write_bits(1, 1);
+  write_bits(value, bits - 1); // the leading 1 is implied
+}
+
+void GameRecordWriter::flush_block() {
+  if (block_games == 0) {
+    return;
+  }
+  index.push_back({ static_cast<uint64_t>(file.tellp()), game_count - block_games });
+  file.write(BLOCK_MAGIC, 4);
+  write_number(file, block_games, 4);
+  write_number(file, block.size(), 4);
+  file.write(reinterpret_cast<const char*>(block.data()), block.size());
+  block.clear();
+  block_bits = 0;
+  block_games = 0;
+}
+
+void GameRecordWriter::begin_game() {
+  board.reset(new Chessboard(*start));
+  game_moves.clear();
+}
+
+bool GameRecordWriter::add_move(const Move& move) {
+  if (board == nullptr) {
+    begin_game();
+  }
+  board->generate_moves(moves);
+  for (size_t i = 0; i < moves.size(); i++) {
+    if (moves[i].from == move.from && moves[i].to == move.to) {
+      game_moves.push_back(static_cast<uint32_t>(i));
+      game_moves.push_back(static_cast<uint32_t>(bit_width(moves.size() - 1)));
+      delete board->make_move(move);
+      return true;
+    }
+  }
+  error = ChessError::ILLEGAL_MOVE;
+  return false;
+}
+
+void GameRecordWriter::end_game(GameState result) {
+  if (!is_open() || board == nullptr) {
+    return;
+  }
+  uint64_t move_count = game_moves.size() / 2 + 1;
+  uint64_t bits = 2 * bit_width(move_count) - 1 + RESULT_BITS;
+  for (size_t i = 1; i < game_moves.size(); i += 2) {
+    bits += game_moves[i];
+  }
+  // the length first, so that the reader can skip games without replaying them
+  write_gamma(bits + 1);
+  write_gamma(move_count);
+  write_bits(static_cast<uint64_t>(result), RESULT_BITS);
+  for (size_t i = 0; i < game_moves.size(); i += 2) {
+    write_bits(game_moves[i], game_moves[i + 1]);
+  }
+  game_count++;
+  block_games++;
+  if (block.size() >= BLOCK_BYTES) {
+    flush_block();
+  }
+  board.reset();
+}
+
+void GameRecordWriter::close() {
+  if (!is_open()) {
+    return;
+  }
+  flush_block();
+  uint64_t index_offset = static_cast<uint64_t>(file.tellp());
+  for (const std::pair<uint64_t, uint32_t>& entry : index) {
+    write_number(file, entry.first, 8);
+    write_number(file, entry.second, 4);
+  }
+  write_number(file, index.size(), 4);
+  write_number(file, index_offset, 8);
+  file.write(INDEX_MAGIC, 4);
+  file.close();
+}
+
+GameRecordReader::GameRecordReader(const std::string& path)
+  : file(path, std::ios::binary) {
+  if (!file) {
+    error = ChessError::FILE_NOT_OPENED;
+    return;
+  }
+  if (!read_header()) {
+    error = ChessError::NOT_A_GAME_RECORD;
+    return;
+  }
+  uint64_t first_block = static_cast<uint64_t>(file.tellg());
+  file.seekg(0, std::ios::end);
+  file_size = static_cast<uint64_t>(file.tellg());
+  if (!read_index(first_block) && !scan_blocks(first_block)) {
+    error = ChessError::DAMAGED_GAME_RECORD;
+    return;
+  }
+  start.reset(new Chessboard(false, size, rules, fairy_pieces));
+  board.reset(new Chessboard(*start));
+}
+
+bool GameRecordReader::read_header() {
+  char magic[4];
+  uint64_t value, definitions;
+  if (!file.read(magic, 4) || !std::equal(magic, magic + 4, RECORD_MAGIC) ||
+    !read_number(file, value, 1) || value < MIN_BOARD_SIZE || value > MAX_BOARD_SIZE) {
+    return false;
+  }
+  size = static_cast<int>(value);
+  if (!read_number(file, value, 1) || value > static_cast<uint64_t>(RuleSet::CHECKMATE) ||
+    !read_number(file, definitions, 1)) {
+    return false;
+  }
+  rules = static_cast<RuleSet>(value);
+  for (uint64_t i = 0; i < definitions; i++) {
+    PieceDefinition definition;
+    MovePattern pattern;
+    std::string error;
+    uint64_t squares;
+    if (!read_number(file, value, 1) || !read_text(file, definition.betza) ||
+      !parse_betza(definition.betza, pattern, error) || !read_number(file, squares, 1)) {
+      return false;
+    }
+    definition.symbol = static_cast<char>(value);
+    definition.pattern = std::make_shared<const MovePattern>(pattern);
+    definition.start_squares.resize(static_cast<size_t>(squares));
+    for (std::string& square : definition.start_squares) {
+      if (!read_text(file, square)) {
+        return false;
+      }
+    }
+    fairy_pieces.push_back(definition);
+  }
+  return true;
+}
+
+/// <summary>
+/// reads the index at the end of the file; false if it is missing or does not
+/// fit the file: the blocks must lie between the header and the index, in
+/// order, and the first games must count up from 0
+/// </summary>
+bool GameRecordReader::read_index(uint64_t first_block) {
+  char magic[4];
+  uint64_t blocks, offset;
+  if (file_size < first_block + TRAILER_BYTES) {
+    return false;
+  }
+  uint64_t index_end = file_size - TRAILER_BYTES;
+  file.seekg(index_end);
+  if (!file || !read_number(file, blocks, 4) || !read_number(file, offset, 8) ||
+    !file.read(magic, 4) || !std::equal(magic, magic + 4, INDEX_MAGIC) ||
+    offset < first_block || offset > index_end || blocks > (index_end - offset) / INDEX_ENTRY_BYTES) {
+    file.clear();
+    return false;
+  }
+  file.seekg(offset);
+  uint64_t block_start = first_block;
+  for (uint64_t i = 0; i < blocks; i++) {
+    uint64_t block_offset, first_game;
+    if (!read_number(file, block_offset, 8) || !read_number(file, first_game, 4) ||
+      block_offset < block_start || block_offset > offset || offset - block_offset < BLOCK_HEADER_BYTES ||
+      (i == 0 ? first_game != 0 : first_game <= index.back().second)) {
+      file.clear();
+      index.clear();
+      return false;
+    }
+    index.push_back({ block_offset, static_cast<uint32_t>(first_game) });
+    block_start = block_offset + BLOCK_HEADER_BYTES;
+  }
+  // the number of games follows from the last block
+  game_count = 0;
+  if (!index.empty()) {
+    uint64_t games;
+    file.seekg(index.back().first + 4);
+    if (!read_number(file, games, 4) || games == 0 || games > UINT32_MAX - index.back().second) {
+      file.clear();
+      index.clear();
+      return false;
+    }
+    game_count = index.back().second + static_cast<uint32_t>(games);
+  }
+  return true;
+}
+
+/// <summary>
+/// rebuilds the index by walking from block to block; a block cut off at the
+/// end of the file is dropped
+/// </summary>
+bool GameRecordReader::scan_blocks(uint64_t offset) {
+  file.clear();
+  index.clear();
+  game_count = 0;
+  while (offset + BLOCK_HEADER_BYTES <= file_size) {
+    char magic[4];
+    uint64_t games, bytes;
+    file.seekg(offset);
+    if (!file.read(magic, 4) || !std::equal(magic, magic + 4, BLOCK_MAGIC) ||
+      !read_number(file, games, 4) || !read_number(file, bytes, 4) ||
+      offset + BLOCK_HEADER_BYTES + bytes > file_size) {
+      break;
+    }
+    index.push_back({ offset, game_count });
+    game_count += static_cast<uint32_t>(games);
+    offset += BLOCK_HEADER_BYTES + bytes;
+  }
+  file.clear();
+  return true;
+}
+
+bool GameRecordReader::load_block(size_t number) {
+  if (loaded_block == number) {
+    return true;
+  }
+  char magic[4];
+  uint64_t games, bytes;
+  file.seekg(index[number].first);
+  if (!file.read(magic, 4) || !std::equal(magic, magic + 4, BLOCK_MAGIC) ||
+    !read_number(file, games, 4) || !read_number(file, bytes, 4) ||
+    index[number].first + BLOCK_HEADER_BYTES + bytes > file_size) {
+    file.clear();
+    return false;
+  }
+  block.assign(static_cast<size_t>(bytes) + 8, 0); // padding for read_bits
+  if (!file.read(reinterpret_cast<char*>(block.data()), bytes)) {
+    file.clear();
+    return false;
+  }
+  loaded_block = number;
+  return true;
+}
+
+bool GameRecordReader::read_game(uint32_t game, std::vector<Move>& game_moves, GameState& result) {
+  game_moves.clear();
+  if (!is_open() || game >= game_count) {
+    return false;
+  }
+  size_t number = std::upper_bound(index.begin(), index.end(), game,
+    [](uint32_t value, const std::pair<uint64_t, uint32_t>& entry) { return value < entry.second; }) -
+    index.begin() - 1;
+  if (!load_block(number)) {
+    return false;
+  }
+
+  // reading the games one after another needs no skipping
+  uint64_t end = (block.size() - 8) * 8;
+  uint64_t position = 0;
+  uint32_t skipped = index[number].second;
+  if (next_game == game && next_block == number) {
+    position = next_position;
+    skipped = game;
+  }
+  uint64_t length, move_count, result_bits;
+  for (; skipped < game; skipped++) {
+    if (!read_gamma(block, end, position, length)) {
+      return false;
+    }
+    position += length - 1;
+  }
+  if (!read_gamma(block, end, position, length)) {
+    return false;
+  }
+  length--;
+  next_game = game + 1;
+  next_block = number;
+  next_position = position + length;
+  if (!read_gamma(block, end, position, move_count) ||
+    !read_bits(block, end, position, RESULT_BITS, result_bits) ||
+    result_bits > static_cast<uint64_t>(GameState::DRAW_BY_NO_CAPTURE)) {
+    return false;
+  }
+  move_count--;
+  result = static_cast<GameState>(result_bits);
+
+  board.reset(new Chessboard(*start));
+  for (uint64_t i = 0; i < move_count; i++) {
+    board->generate_moves(moves);
+    if (moves.empty()) {
+      return false;
+    }
+    uint64_t choice;
+    if (!read_bits(block, end, position, bit_width(moves.size() - 1), choice) || choice >= moves.size()) {
+      return false;
+    }
+    game_moves.push_back(moves[static_cast<size_t>(choice)]);
+    delete board->make_move(moves[static_cast<size_t>(choice)]);
+  }
+  return true;
+}
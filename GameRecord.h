@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Chessboard.h"
+#include "PieceDefinition.h"
+
+/// <summary>
+/// binary game log. A move is stored as its index in the move list that
+/// generate_moves produces for the position, in just as many bits as that
+/// list needs (a list of 20 moves costs 5 bits), so a log can only be read
+/// by replaying it. Layout:
+///
+///   header  "CGR1", size, rules, fairy pieces (symbol, betza, start squares)
+///   blocks  "CGRB", game count, byte count, bit stream of about 64 KiB; per game:
+///           gamma(bits + 1), gamma(moves + 1), 4 bit result, move indices
+///   index   per block: offset and first game; block count, index offset, "CGRI"
+///
+/// Games always start from the start position of the board configuration.
+/// Without the index (e.g. the writer was killed) the reader scans the blocks.
+/// </summary>
+class GameRecordWriter {
+private:
+  std::ofstream file;
+  std::unique_ptr<Chessboard> start;
+  std::unique_ptr<Chessboard> board; // replays the game to number the moves
+  std::vector<Move> moves;
+  std::vector<uint32_t> game_moves;  // index and bit width of every move
+  std::vector<uint8_t> block;
+  uint64_t block_bits = 0;
+  uint32_t block_games = 0;
+  uint32_t game_count = 0;
+  std::vector<std::pair<uint64_t, uint32_t>> index; // block offset, first game
+  ChessError error = ChessError::NONE;
+
+  void write_bits(uint64_t value, int bits);
+  void write_gamma(uint64_t value);
+  void flush_block();
+
+public:
+  GameRecordWriter(const std::string& path, int size, RuleSet rules,
+    const std::vector<PieceDefinition>& fairy_pieces);
+  ~GameRecordWriter();
+
+  bool is_open() const { return file.is_open(); }
+  // FILE_NOT_OPENED, or ILLEGAL_MOVE once a move could not be recorded
+  ChessError get_error() const { return error; }
+  void begin_game();
+  // the move must be legal in the current position of the game
+  bool add_move(const Move& move);
+  void end_game(GameState result);
+  // writes the last block and the index
+  void close();
+};
+
+class GameRecordReader {
+private:
+  std::ifstream file;
+  int size = 8;
+  RuleSet rules = RuleSet::CAPTURE_KING;
+  std::vector<PieceDefinition> fairy_pieces;
+  std::unique_ptr<Chessboard> start;
+  std::unique_ptr<Chessboard> board;
+  std::vector<std::pair<uint64_t, uint32_t>> index;
+  uint64_t file_size = 0;
+  uint32_t game_count = 0;
+  size_t loaded_block = SIZE_MAX;
+  std::vector<uint8_t> block;
+  uint32_t next_game = 0;        // where the game after the last one read starts
+  size_t next_block = SIZE_MAX;
+  uint64_t next_position = 0;
+  std::vector<Move> moves;
+  ChessError error = ChessError::NONE;
+
+  bool read_header();
+  bool read_index(uint64_t first_block);
+  bool scan_blocks(uint64_t offset);
+  bool load_block(size_t number);
+
+public:
+  GameRecordReader(const std::string& path);
+
+  bool is_open() const { return start != nullptr; }
+  // why the record could not be opened
+  ChessError get_error() const { return error; }
+  int get_size() const { return size; }
+  RuleSet get_rules() const { return rules; }
+  const std::vector<PieceDefinition>& get_fairy_pieces() const { return fairy_pieces; }
+  uint32_t get_game_count() const { return game_count; }
+
+  // replays game number game (counted from 0); false if the log is damaged
+  bool read_game(uint32_t game, std::vector<Move>& game_moves, GameState& result);
+  // the last position of the game read last
+  const Chessboard& get_board() const { return *board; }
+};
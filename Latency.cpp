@@ -0,0 +1,82 @@
+#include "Latency.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+/// <summary>
+/// values below SUB_BUCKETS get a bucket each; above, every power of two is
+/// split into SUB_BUCKETS buckets of equal width
+/// </summary>
+int LatencyHistogram::bucket_of(uint64_t microseconds) {
+  if (microseconds < SUB_BUCKETS) {
+    return static_cast<int>(microseconds);
+  }
+  int shift = 0;
+  while ((microseconds >> shift) >= 2 * SUB_BUCKETS) {
+    shift++;
+  }
+  int bucket = (shift + 1) * SUB_BUCKETS + static_cast<int>(microseconds >> shift) - SUB_BUCKETS;
+  return std::min(bucket, BUCKETS - 1);
+}
+
+// the largest value that falls into the bucket
+uint64_t LatencyHistogram::upper_bound(int bucket) {
+  if (bucket < SUB_BUCKETS) {
+    return static_cast<uint64_t>(bucket);
+  }
+  int shift = bucket / SUB_BUCKETS - 1;
+  uint64_t first = static_cast<uint64_t>(bucket % SUB_BUCKETS + SUB_BUCKETS) << shift;
+  return first + (uint64_t(1) << shift) - 1;
+}
+
+void LatencyHistogram::record(std::chrono::steady_clock::duration duration) {
+  auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+  record_microseconds(static_cast<uint64_t>(std::max<int64_t>(microseconds, 0)));
+}
+
+void LatencyHistogram::record_microseconds(uint64_t microseconds) {
+  buckets[bucket_of(microseconds)].fetch_add(1, std::memory_order_relaxed);
+  count.fetch_add(1, std::memory_order_relaxed);
+  uint64_t previous = maximum.load(std::memory_order_relaxed);
+  while (previous < microseconds &&
+    !maximum.compare_exchange_weak(previous, microseconds, std::memory_order_relaxed)) {
+  }
+}
+
+uint64_t LatencyHistogram::percentile(double p) const {
+  uint64_t total = get_count();
+  if (total == 0) {
+    return 0;
+  }
+  uint64_t rank = std::max<uint64_t>(static_cast<uint64_t>(std::ceil(p * total)), 1);
+  uint64_t seen = 0;
+  for (int bucket = 0; bucket < BUCKETS; bucket++) {
+    seen += buckets[bucket].load(std::memory_order_relaxed);
+    if (seen >= rank) {
+      return std::min(upper_bound(bucket), get_max());
+    }
+  }
+  return get_max();
+}
+
+static std::string format_microseconds(uint64_t microseconds) {
+  std::ostringstream text;
+  if (microseconds < 1000) {
+    text << microseconds << " us";
+  }
+  else if (microseconds < 10000000) {
+    text.precision(3);
+    text << microseconds / 1000.0 << " ms";
+  }
+  else {
+    text.precision(3);
+    text << microseconds / 1000000.0 << " s";
+  }
+  return text.str();
+}
+
+std::string LatencyHistogram::summary(const std::string& unit) const {
+  return std::to_string(get_count()) + ' ' + unit + ": p50 " + format_microseconds(percentile(0.5)) +
+    ", p99 " + format_microseconds(percentile(0.99)) + ", max " + format_microseconds(get_max());
+}
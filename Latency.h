@@ -0,0 +1,36 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/// <summary>
+/// distribution of durations (e.g. the time per move) in logarithmic
+/// buckets: 16 per power of two, so a percentile is off by at most 1/16,
+/// in constant memory however many durations are recorded. record() may be
+/// called from several threads at once.
+/// </summary>
+class LatencyHistogram {
+private:
+  static constexpr int SUB_BUCKETS = 16;
+  static constexpr int BUCKETS = SUB_BUCKETS * 41; // up to 2^44 microseconds
+
+  std::atomic<uint64_t> buckets[BUCKETS] = {};
+  std::atomic<uint64_t> count{ 0 };
+  std::atomic<uint64_t> maximum{ 0 };
+
+  static int bucket_of(uint64_t microseconds);
+  static uint64_t upper_bound(int bucket);
+
+public:
+  void record(std::chrono::steady_clock::duration duration);
+  void record_microseconds(uint64_t microseconds);
+
+  uint64_t get_count() const { return count.load(std::memory_order_relaxed); }
+  uint64_t get_max() const { return maximum.load(std::memory_order_relaxed); }
+  // microseconds that the share p (0..1) of the durations did not exceed
+  uint64_t percentile(double p) const;
+  // "93 moves: p50 12 us, p99 1.3 ms, max 2.1 ms"
+  std::string summary(const std::string& unit) const;
+};
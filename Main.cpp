@@ -1,10 +1,31 @@
-﻿#include <Windows.h>
+﻿#ifdef _WIN32
+#include <Windows.h>
+#endif
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <tuple>
+#include <vector>
 
+#include "Analysis.h"
+#include "BatchBoards.h"
 #include "Chessboard.h"
 #include "Chesspiece.h"
 #include "Colors.h"
+#include "EngineProtocol.h"
+#include "GameRecord.h"
+#include "Latency.h"
+#include "OpeningBook.h"
+#include "Ponder.h"
+#include "PieceDefinition.h"
+#include "Stats.h"
+#include "Trace.h"
+#include "Validation.h"
 
 using std::cin;
 using std::cout;
@@ -12,9 +33,33 @@ using std::endl;
 using std::string;
 
 constexpr bool USE_UTF8 = false;
+constexpr RuleSet RULES = RuleSet::CAPTURE_KING; // RuleSet::CHECKMATE for real chess rules
+constexpr int ENGINE_DEPTH = 5;                  // search limits of the engine opponent
+constexpr int64_t ENGINE_CLOCK = 300000;         // milliseconds for all moves of the engine
+constexpr int64_t ENGINE_INCREMENT = 2000;       // milliseconds added after every engine move
+constexpr int PLAYOUT_BATCH = 64;                // boards played in lockstep by --playouts
 
 #define DEBUG(exp) cout << std::boolalpha << (#exp) << " = " << (exp) << endl
 
+// settings given on the command line
+struct GameOptions {
+  std::vector<PieceDefinition> fairy_pieces;
+  bool print_stats = false;
+  bool engine_mode = false; // line protocol on stdin/stdout instead of the console game
+  string trace_file; // empty: no tracing
+  string record_file; // empty: the game is not recorded
+  string replay_file; // replay a game record instead of playing
+  string analyze_file; // analyze the positions of this file instead of playing
+  SearchLimits analyze_limits;
+  int threads = 0;     // for the analysis, 0: one per hardware thread
+  uint64_t validate_positions = 0; // > 0: check the move generation instead of playing
+  int no_capture_limit = NO_CAPTURE_LIMIT; // moves without capture until a draw, 0: none
+  uint64_t playouts = 0; // > 0: play that many random games on a batch of boards
+  string book_file;      // book moves for the automatic game and the engine, empty: none
+  string build_book_file; // build a book from the game records given instead of moves
+  uint64_t selfplay_games = 0; // > 0: play that many automatic games silently (into the record)
+};
+
 static string get_player_color(Chessboard* board) {
   return board->is_whites_turn() ? "white" : "black";
 }
@@ -57,7 +102,7 @@ static bool select_piece(Chessboard* board) {
   }
   if (board->can_select_piece(row, col)) {
     board->select_piece(row, col);
-    board->show();
+    board->show(cout);
     return true;
   }
   else {
@@ -74,7 +119,7 @@ static bool move_piece(Chessboard* board) {
   }
   if (board->can_move_selection_to(row, col)) {
     board->move_selection_to(row, col);
-    board->show();
+    board->show(cout);
     return true;
   }
   else {
@@ -82,15 +127,72 @@ static bool move_piece(Chessboard* board) {
   }
 }
 
-static void print_game_over(const Chessboard& board, int number_of_moves) {
+static void print_game_over(GameState state, int number_of_moves) {
+  if (state == GameState::STALEMATE) {
+    cout << BOLD << "Stalemate" << RESET << " after " << number_of_moves << " moves." << endl;
+    return;
+  }
+  if (state == GameState::DRAW_BY_REPETITION || state == GameState::DRAW_BY_NO_CAPTURE) {
+    cout << BOLD << "Draw" << RESET << " after " << number_of_moves << " moves by "
+      << (state == GameState::DRAW_BY_REPETITION ? "repetition" : "moves without a capture") << '.' << endl;
+    return;
+  }
   cout << BOLD;
-  if (board.is_game_over() == GameState::WHITE_LOST) {
-    cout << "White";
+  if (state == GameState::WHITE_LOST || state == GameState::WHITE_CHECKMATED) {
+    cout << "Black";
   }
   else {
-    cout << "Black";
+    cout << "White";
+  }
+  cout << RESET << " has won in " << number_of_moves << " moves";
+  if (state == GameState::WHITE_CHECKMATED || state == GameState::BLACK_CHECKMATED) {
+    cout << " by checkmate";
+  }
+  cout << '.' << endl;
+}
+
+/// <summary>
+/// a writer for games of the board's configuration, nullptr if the file
+/// cannot be created
+/// </summary>
+static std::unique_ptr<GameRecordWriter> create_record(const string& path, const Chessboard& board) {
+  std::unique_ptr<GameRecordWriter> writer(new GameRecordWriter(path,
+    board.get_size(), board.get_rules(), board.get_fairy_pieces()));
+  if (!writer->is_open()) {
+    std::cerr << "Could not create game record '" << path << "'." << endl;
+    return nullptr;
+  }
+  return writer;
+}
+
+/// <summary>
+/// starts writing the moves played on board to the record file (if any);
+/// the board must not outlive the returned writer
+/// </summary>
+static std::unique_ptr<GameRecordWriter> start_recording(Chessboard& board, const GameOptions& options) {
+  if (options.record_file.empty()) {
+    return nullptr;
+  }
+  std::unique_ptr<GameRecordWriter> writer = create_record(options.record_file, board);
+  if (writer != nullptr) {
+    writer->begin_game();
+    board.set_recorder(writer.get());
+  }
+  return writer;
+}
+
+static void finish_recording(GameRecordWriter* writer, Chessboard& board) {
+  if (writer != nullptr) {
+    writer->end_game(board.is_game_over());
+    board.set_recorder(nullptr);
+  }
+}
+
+// after the last game of a record
+static void report_recording(const GameRecordWriter* writer) {
+  if (writer != nullptr && writer->get_error() != ChessError::NONE) {
+    std::cerr << "Game record: " << error_message(writer->get_error()) << '.' << endl;
   }
-  cout << RESET << " has one in " << number_of_moves << " moves." << endl;
 }
 
 static int random(int min, int max) //range : [min, max]
@@ -98,55 +200,219 @@ static int random(int min, int max) //range : [min, max]
   return min + rand() % ((max + 1) - min);
 }
 
-void play_automatic_game() {
-  Chessboard board = Chessboard(USE_UTF8);
+/// <summary>
+/// plays random moves until the game is over, book moves (drawn by how often
+/// they were played) while the book knows the position; returns the number of moves
+/// </summary>
+static int play_random_moves(Chessboard& board, const OpeningBook& book, LatencyHistogram& latency) {
   int number_of_moves = 0;
-  char rand_row = 'A';
-  int rand_col = 1;
   int board_size = board.get_size();
+  std::vector<Move> moves;
+  Move book_move;
   while (board.is_game_over() == GameState::PLAY_ON) {
-    while (!board.can_select_piece(rand_row, rand_col)) {
-      rand_row = random(0, board_size - 1) + 'A';
-      rand_col = random(1, board_size);
+    auto start = std::chrono::steady_clock::now();
+    if (book.pick_by_frequency(board, static_cast<uint64_t>(rand()), book_move)) {
+      board.play_move(book_move);
     }
-    board.select_piece(rand_row, rand_col);
+    else {
+      // draw figures of the player on turn (not squares) until one can move
+      const std::vector<int>& squares = board.get_piece_squares(board.is_whites_turn());
+      int from = squares[random(0, static_cast<int>(squares.size()) - 1)];
+      while (!board.can_select_piece(from % board_size + 'A', board_size - from / board_size)) {
+        COUNT_STAT(Counter::REJECTED_DRAW);
+        from = squares[random(0, static_cast<int>(squares.size()) - 1)];
+      }
+      board.select_piece(from % board_size + 'A', board_size - from / board_size);
 
-    while (!board.can_move_selection_to(rand_row, rand_col)) {
-      rand_row = random(0, board_size - 1) + 'A';
-      rand_col = random(1, board_size);
+      // then one of its moves
+      board.generate_moves(moves);
+      moves.erase(std::remove_if(moves.begin(), moves.end(),
+        [from](const Move& move) { return move.from != from; }), moves.end());
+      int to = moves[random(0, static_cast<int>(moves.size()) - 1)].to;
+      board.move_selection_to(to % board_size + 'A', board_size - to / board_size);
     }
-    board.move_selection_to(rand_row, rand_col);
-    //board->show();
+    latency.record(std::chrono::steady_clock::now() - start);
+    //board->show(cout);
     number_of_moves++;
   }
-  board.show();
-  print_game_over(&board, number_of_moves);
+  return number_of_moves;
+}
+
+static void open_book(OpeningBook& book, const GameOptions& options) {
+  if (options.book_file.empty()) {
+    return;
+  }
+  if (book.open(options.book_file)) {
+    cout << "Book '" << options.book_file << "' with " << book.get_entry_count() << " moves." << endl;
+  }
+  else {
+    std::cerr << "Could not open the book '" << options.book_file << "': "
+      << error_message(book.get_error()) << '.' << endl;
+  }
+}
+
+void play_automatic_game(const GameOptions& options) {
+  Chessboard board = Chessboard(USE_UTF8, 8, RULES, options.fairy_pieces);
+  board.set_no_capture_limit(options.no_capture_limit);
+  std::unique_ptr<GameRecordWriter> recorder = start_recording(board, options);
+  OpeningBook book;
+  open_book(book, options);
+  LatencyHistogram latency;
+  int number_of_moves = play_random_moves(board, book, latency);
+  finish_recording(recorder.get(), board);
+  report_recording(recorder.get());
+  board.show(cout);
+  print_game_over(board.is_game_over(), number_of_moves);
+  cout << "Time per move: " << latency.summary("moves") << endl;
+}
+
+/// <summary>
+/// automatic games without output, all into one record (e.g. to build a book)
+/// </summary>
+static void play_selfplay_games(const GameOptions& options) {
+  Chessboard start(USE_UTF8, 8, RULES, options.fairy_pieces);
+  start.set_no_capture_limit(options.no_capture_limit);
+  std::unique_ptr<GameRecordWriter> recorder;
+  if (!options.record_file.empty()) {
+    recorder = create_record(options.record_file, start);
+  }
+  OpeningBook book;
+  open_book(book, options);
+  LatencyHistogram latency;
+  auto begin = std::chrono::steady_clock::now();
+  uint64_t white_won = 0, black_won = 0;
+  for (uint64_t game = 0; game < options.selfplay_games; game++) {
+    Chessboard board(start);
+    if (recorder) {
+      recorder->begin_game();
+      board.set_recorder(recorder.get());
+    }
+    play_random_moves(board, book, latency);
+    GameState result = board.is_game_over();
+    white_won += result == GameState::BLACK_LOST || result == GameState::BLACK_CHECKMATED;
+    black_won += result == GameState::WHITE_LOST || result == GameState::WHITE_CHECKMATED;
+    finish_recording(recorder.get(), board);
+  }
+  report_recording(recorder.get());
+  uint64_t drawn = options.selfplay_games - white_won - black_won;
+  cout << options.selfplay_games << " games played in " << std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - begin).count() << " ms: white won " << white_won << ", black won "
+    << black_won << ", " << drawn << " drawn." << endl;
+  cout << "Time per move: " << latency.summary("moves") << endl;
+}
+
+/// <summary>
+/// counts the opening moves of all games in the records and writes the book
+/// </summary>
+static bool build_book(const string& path, int argc, char* argv[], int first_record) {
+  OpeningBookBuilder builder;
+  for (int i = first_record; i < argc; i++) {
+    ChessError error = builder.add_record(argv[i]);
+    if (error != ChessError::NONE) {
+      std::cerr << "'" << argv[i] << "': " << error_message(error) << '.' << endl;
+    }
+  }
+  int64_t entries = builder.write(path);
+  if (entries < 0) {
+    std::cerr << "Could not write the book '" << path << "'." << endl;
+    return false;
+  }
+  cout << "Book '" << path << "' with " << entries << " moves from " << builder.get_game_count()
+    << " games written." << endl;
+  return true;
 }
 
-void play_manual_game() {
-  Chessboard board = Chessboard(USE_UTF8);
-  board.show();
+/// <summary>
+/// lets the engine answer; uses the pondered reply if the human played the
+/// guessed move and it is already deep enough. The time is taken from the
+/// engine's clock (milliseconds), which gets the increment afterwards.
+/// Book moves are played without searching.
+/// </summary>
+static void engine_move(Chessboard& board, Search& search, Ponderer& ponderer, const OpeningBook& book,
+  int64_t& clock, LatencyHistogram& latency) {
+  auto start = std::chrono::steady_clock::now();
+  SearchResult reply;
+  bool ponder_hit = ponderer.finish(board, reply);
+  bool book_hit = book.pick_best(board, reply.best_move);
+  if (book_hit) {
+    reply.has_move = true;
+  }
+  else if (!ponder_hit || reply.depth < ENGINE_DEPTH) {
+    Chessboard position(board);
+    SearchLimits limits;
+    limits.depth = ENGINE_DEPTH;
+    limits.clock = std::max<int64_t>(clock, 1);
+    limits.increment = ENGINE_INCREMENT;
+    reply = search.run(position, limits);
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  latency.record(elapsed);
+  auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+  clock = std::max<int64_t>(clock - milliseconds, 0) + ENGINE_INCREMENT;
+  if (reply.has_move) {
+    cout << "Engine plays " << BOLD << board.move_to_string(reply.best_move) << RESET
+      << " (" << milliseconds << " ms" << (book_hit ? ", book" : ponder_hit ? ", ponder hit" : "") << ", "
+      << clock / 1000 << " s left)." << endl;
+    board.play_move(reply.best_move);
+  }
+  board.show(cout);
+}
+
+void play_manual_game(const GameOptions& options, bool against_engine) {
+  Chessboard board = Chessboard(USE_UTF8, 8, RULES, options.fairy_pieces);
+  board.set_no_capture_limit(options.no_capture_limit);
+  std::unique_ptr<GameRecordWriter> recorder = start_recording(board, options);
+  Search search;
+  Ponderer ponderer(search);
+  OpeningBook book;
+  if (against_engine) {
+    open_book(book, options);
+  }
+  int64_t engine_clock = ENGINE_CLOCK;
+  LatencyHistogram latency;
+  board.show(cout);
   bool continue_game = true;
   int number_of_moves = 0;
   while (continue_game) {
-    cout << "Player " << BOLD << get_player_color(&board) << RESET << ' '
-      << "is on turn." << endl;
-    continue_game = select_piece(&board);
-    if (continue_game) {
-      continue_game = move_piece(&board);
+    if (against_engine && !board.is_whites_turn()) { // the engine plays black
+      engine_move(board, search, ponderer, book, engine_clock, latency);
       number_of_moves++;
     }
-    if (board.is_game_over() != GameState::PLAY_ON) {
+    else {
+      cout << "Player " << BOLD << get_player_color(&board) << RESET << ' '
+        << "is on turn." << endl;
+      if (board.in_check()) {
+        cout << BOLDRED << "Check!" << RESET << endl;
+      }
+      if (against_engine) { // think about the reply while the human is typing
+        ponderer.start(board);
+      }
+      continue_game = select_piece(&board);
+      if (continue_game) {
+        continue_game = move_piece(&board);
+        number_of_moves++;
+      }
+    }
+    GameState state = board.is_game_over();
+    if (state != GameState::PLAY_ON) {
       continue_game = false;
-      print_game_over(&board, number_of_moves);
+      print_game_over(state, number_of_moves);
     }
   }
+  ponderer.cancel();
+  finish_recording(recorder.get(), board);
+  report_recording(recorder.get());
+  if (latency.get_count() > 0) {
+    cout << "Engine time per move: " << latency.summary("moves") << endl;
+  }
 }
 
-void play_game_from_args(int argc, char* argv[]) {
-  Chessboard board = Chessboard(USE_UTF8);
+void play_game_from_args(int argc, char* argv[], int first_move, const GameOptions& options) {
+  Chessboard board = Chessboard(USE_UTF8, 8, RULES, options.fairy_pieces);
+  board.set_no_capture_limit(options.no_capture_limit);
+  std::unique_ptr<GameRecordWriter> recorder = start_recording(board, options);
   int number_of_moves = 0;
-  for (size_t i = 1; i < argc; i++)
+  for (int i = first_move; i < argc; i++)
   {
     string move = string(argv[i]);
     // check format
@@ -178,34 +444,256 @@ void play_game_from_args(int argc, char* argv[]) {
     board.move_selection_to(row, col);
     number_of_moves++;
   }
-  board.show();
-  if (board.is_game_over() != GameState::PLAY_ON) {
-    print_game_over(&board, number_of_moves);
+  finish_recording(recorder.get(), board);
+  report_recording(recorder.get());
+  board.show(cout);
+  GameState state = board.is_game_over();
+  if (state != GameState::PLAY_ON) {
+    print_game_over(state, number_of_moves);
+  }
+}
+
+/// <summary>
+/// replays every game of a record and shows the end of the last one
+/// </summary>
+static void replay_games(const string& path) {
+  GameRecordReader reader(path);
+  if (!reader.is_open()) {
+    std::cerr << "'" << path << "': " << error_message(reader.get_error()) << '.' << endl;
+    return;
+  }
+  auto start = std::chrono::steady_clock::now();
+  std::vector<Move> moves;
+  GameState result = GameState::PLAY_ON;
+  uint64_t total_moves = 0;
+  uint32_t game = 0;
+  for (; game < reader.get_game_count(); game++) {
+    if (!reader.read_game(game, moves, result)) {
+      cout << "Game " << game + 1 << " of the record is damaged." << endl;
+      break;
+    }
+    total_moves += moves.size();
+  }
+  auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - start).count();
+  cout << game << " games with " << total_moves << " moves replayed in " << milliseconds << " ms";
+  if (milliseconds > 0) {
+    cout << " (" << total_moves * 1000 / milliseconds << " moves/s)";
+  }
+  cout << '.' << endl;
+  if (game > 0 && game == reader.get_game_count()) {
+    reader.get_board().show(cout);
+    if (result != GameState::PLAY_ON) {
+      print_game_over(result, static_cast<int>(moves.size()));
+    }
+  }
+}
+
+/// <summary>
+/// batch analysis of a positions file, results on stdout
+/// </summary>
+static void analyze_file(const GameOptions& options) {
+  std::ifstream positions(options.analyze_file);
+  if (!positions) {
+    cout << "Could not open positions '" << options.analyze_file << "'." << endl;
+    return;
   }
+  AnalysisSettings settings;
+  settings.limits = options.analyze_limits;
+  settings.threads = options.threads;
+  settings.rules = RULES;
+  settings.fairy_pieces = options.fairy_pieces;
+  auto start = std::chrono::steady_clock::now();
+  LatencyHistogram latency;
+  size_t count = analyze_positions(positions, cout, settings, &latency);
+  std::cerr << count << " positions analyzed in " << std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - start).count() << " ms (" << latency.summary("positions") << ")." << endl;
+}
+
+/// <summary>
+/// random games from the start position on a batch of boards (always with
+/// the capture rules), then how they ended and how fast they were
+/// </summary>
+static void run_playouts(const GameOptions& options) {
+  Chessboard start(false, 8, RuleSet::CAPTURE_KING, options.fairy_pieces);
+  BatchBoards batch(PLAYOUT_BATCH, start.get_size(), options.fairy_pieces, static_cast<uint64_t>(time(0)));
+  batch.set_no_capture_limit(options.no_capture_limit);
+  if (!batch.add_start_position(start, options.playouts)) {
+    std::cerr << "The start position does not fit the boards of the batch." << endl;
+    return;
+  }
+  uint64_t white_won = 0, black_won = 0, drawn = 0;
+  auto count_results = [&]() {
+    for (const BatchResult& result : batch.get_results()) {
+      white_won += result.result == GameState::BLACK_LOST;
+      black_won += result.result == GameState::WHITE_LOST;
+      drawn += result.result != GameState::BLACK_LOST && result.result != GameState::WHITE_LOST;
+    }
+    batch.clear_results();
+  };
+  auto begin = std::chrono::steady_clock::now();
+  while (batch.step() > 0) {
+    count_results();
+  }
+  count_results();
+  auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - begin).count();
+  cout << options.playouts << " games with " << batch.get_total_plies() << " moves played in "
+    << milliseconds << " ms";
+  if (milliseconds > 0) {
+    cout << " (" << batch.get_total_plies() * 1000 / milliseconds << " moves/s)";
+  }
+  cout << ": white won " << white_won << ", black won " << black_won << ", " << drawn << " drawn." << endl;
 }
 
 int main(int argc, char* argv[]) {
+#ifdef _WIN32
   if (USE_UTF8) {
     SetConsoleOutputCP(CP_UTF8);
   }
+#endif
+
+  // options come first ("--pieces fairy_pieces.txt", "--engine", "--stats", "--trace trace.json",
+  // "--record game.cgr", "--replay game.cgr", "--analyze positions.txt" with "--depth n",
+  // "--nodes n", "--movetime ms" and "--threads n", "--validate positions", "--draw-after moves", "--playouts games",
+  // "--book book.cbk", "--selfplay games", "--build-book book.cbk" with game records after the options),
+  // moves after them
+  GameOptions options;
+  options.analyze_limits.depth = ENGINE_DEPTH;
+  int first_move = 1;
+  while (first_move < argc && string(argv[first_move]).rfind("--", 0) == 0) {
+    string option = argv[first_move++];
+    if (option == "--pieces" && first_move < argc) {
+      string error;
+      if (!load_piece_definitions(argv[first_move++], options.fairy_pieces, error)) {
+        std::cerr << error << '.' << endl;
+        return -1;
+      }
+      // the games are played on boards of size 8, the start squares must fit them
+      ChessError setup_error = Chessboard(false, 8, RULES, options.fairy_pieces).get_error();
+      if (setup_error != ChessError::NONE) {
+        std::cerr << "Warning: " << error_message(setup_error) << '.' << endl;
+      }
+    }
+    else if (option == "--engine") {
+      options.engine_mode = true;
+    }
+    else if (option == "--stats") {
+      options.print_stats = true;
+    }
+    else if (option == "--record" && first_move < argc) {
+      options.record_file = argv[first_move++];
+    }
+    else if (option == "--replay" && first_move < argc) {
+      options.replay_file = argv[first_move++];
+    }
+    else if (option == "--analyze" && first_move < argc) {
+      options.analyze_file = argv[first_move++];
+    }
+    else if (option == "--depth" && first_move < argc) {
+      options.analyze_limits.depth = std::min(std::max(std::atoi(argv[first_move++]), 1), MAX_PLY - 1);
+    }
+    else if (option == "--movetime" && first_move < argc) {
+      options.analyze_limits.move_time = std::max(std::atoll(argv[first_move++]), 1LL);
+      options.analyze_limits.depth = MAX_PLY - 1; // the time budget decides
+    }
+    else if (option == "--nodes" && first_move < argc) {
+      options.analyze_limits.nodes = std::strtoull(argv[first_move++], nullptr, 10);
+      options.analyze_limits.depth = MAX_PLY - 1; // the node budget decides
+    }
+    else if (option == "--validate" && first_move < argc) {
+      options.validate_positions = std::strtoull(argv[first_move++], nullptr, 10);
+    }
+    else if (option == "--playouts" && first_move < argc) {
+      options.playouts = std::strtoull(argv[first_move++], nullptr, 10);
+    }
+    else if (option == "--book" && first_move < argc) {
+      options.book_file = argv[first_move++];
+    }
+    else if (option == "--build-book" && first_move < argc) {
+      options.build_book_file = argv[first_move++];
+    }
+    else if (option == "--selfplay" && first_move < argc) {
+      options.selfplay_games = std::strtoull(argv[first_move++], nullptr, 10);
+    }
+    else if (option == "--draw-after" && first_move < argc) {
+      options.no_capture_limit = std::max(std::atoi(argv[first_move++]), 0);
+    }
+    else if (option == "--threads" && first_move < argc) {
+      options.threads = std::atoi(argv[first_move++]);
+    }
+    else if (option == "--trace" && first_move < argc) {
+      if (tracing_compiled()) {
+        options.trace_file = argv[first_move++];
+        set_tracing(true);
+      }
+      else {
+        std::cerr << "Warning: tracing is not compiled in (define CHESS_TRACE), no trace is written." << endl;
+        first_move++;
+      }
+    }
+    else {
+      cout << "Unknown option (" << option << ")." << endl;
+      return -1;
+    }
+  }
 
+  int exit_code = 0;
+  if (options.engine_mode) {
+    EngineProtocol engine(cin, cout);
+    engine.run();
+  }
+  else if (options.validate_positions > 0) {
+    ValidationSettings settings;
+    settings.positions = options.validate_positions;
+    settings.threads = options.threads;
+    settings.fairy_pieces = options.fairy_pieces;
+    exit_code = validate_move_generation(settings, cout) ? 0 : 1;
+  }
+  else if (options.playouts > 0) {
+    run_playouts(options);
+  }
+  else if (!options.build_book_file.empty()) {
+    exit_code = build_book(options.build_book_file, argc, argv, first_move) ? 0 : 1;
+  }
+  else if (options.selfplay_games > 0) {
+    srand(time(0));
+    play_selfplay_games(options);
+  }
+  else if (!options.replay_file.empty()) {
+    replay_games(options.replay_file);
+  }
+  else if (!options.analyze_file.empty()) {
+    analyze_file(options);
+  }
   // if gameplay is given via console
-  if (argc > 1) {
-    play_game_from_args(argc, argv);
-    return 0;
+  else if (argc > first_move) {
+    play_game_from_args(argc, argv, first_move, options);
   }
+  else {
+    // select game type
+    char game_type;
+    cout << "Select game-type 'a'utomatic, 'm'anual or against the 'e'ngine: ";
+    cin >> game_type;
 
-  // select game type
-  char game_type;
-  cout << "Select game-type 'a'utomatic or 'm'anual: ";
-  cin >> game_type;
+    if (game_type == 'a') { // automatic: the game is played till the end by the computer
+      srand(time(0));
+      play_automatic_game(options);
+    }
+    else if (game_type == 'm') { // manual: the moves are all selected by the user(s)
+      play_manual_game(options, false);
+    }
+    else if (game_type == 'e') { // engine: the user plays white, the engine black
+      play_manual_game(options, true);
+    }
+  }
 
-  if (game_type == 'a') { // automatic: the game is played till the end by the computer
-    srand(time(0));
-    play_automatic_game();
+  if (options.print_stats) {
+    write_stats_json(std::cerr);
   }
-  else if (game_type == 'm') { // manual: the moves are all selected by the user(s)
-    play_manual_game();
+  if (!options.trace_file.empty()) {
+    std::ofstream trace(options.trace_file);
+    write_trace_json(trace);
   }
-  return 0;
+  return exit_code;
 }
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/// <summary>
+/// a file mapped read-only into memory (MapViewOfFile on Windows, mmap
+/// elsewhere): the pages are loaded on first access and shared by every
+/// process that maps the same file
+/// </summary>
+class MappedFile {
+private:
+  const uint8_t* data = nullptr;
+  size_t length = 0;
+
+public:
+  MappedFile() = default;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile() { close(); }
+
+  // false if the file cannot be opened or is empty
+  bool open(const std::string& path);
+  void close();
+
+  bool is_open() const { return data != nullptr; }
+  const uint8_t* get_data() const { return data; }
+  size_t get_length() const { return length; }
+};
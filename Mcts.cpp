@@ -0,0 +1,383 @@
+#include "Mcts.h"
+
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <utility>
+
+#include "Stats.h"
+#include "Trace.h"
+
+// a random game that takes longer than this counts as a draw
+constexpr int PLAYOUT_LIMIT = 400;
+
+// results are counted in half points from the view of white
+constexpr int WHITE_WINS = 2;
+constexpr int DRAW = 1;
+constexpr int BLACK_WINS = 0;
+
+/// <summary>
+/// what every thread needs for itself: its own board (moved down the tree
+/// and back again), move lists and a random generator
+/// </summary>
+struct MctsThread {
+  Chessboard board;
+  std::vector<Move> moves;
+  std::vector<int32_t> path;
+  std::vector<Chesspiece*> captured;
+  std::vector<Move> played;
+  std::vector<Chesspiece*> taken;
+  uint64_t random_state;
+
+  MctsThread(const Chessboard& board, uint64_t seed) : board(board), random_state(seed | 1) {}
+
+  // xorshift64: cheap and good enough to pick random moves
+  uint64_t random() {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    return random_state;
+  }
+};
+
+int32_t NodePool::allocate(int32_t count) {
+  int32_t first = used.load();
+  do {
+    if (first + count > static_cast<int32_t>(nodes.size())) {
+      return -1;
+    }
+  } while (!used.compare_exchange_weak(first, first + count));
+  return first;
+}
+
+static void reset_node(MctsNode& node, const Move& move, int32_t parent) {
+  node.move = move;
+  node.parent = parent;
+  node.first_child.store(-1, std::memory_order_relaxed);
+  node.child_count.store(0, std::memory_order_relaxed);
+  node.state.store(0, std::memory_order_relaxed);
+  node.visits.store(0, std::memory_order_relaxed);
+  node.virtual_loss.store(0, std::memory_order_relaxed);
+  node.score.store(0, std::memory_order_relaxed);
+}
+
+// result of a position without moves
+static int terminal_result(const Chessboard& board) {
+  if (board.get_rules() == RuleSet::CHECKMATE && board.in_check()) {
+    return board.is_whites_turn() ? BLACK_WINS : WHITE_WINS;
+  }
+  return DRAW;
+}
+
+MctsPlayer::MctsPlayer(int threads, double exploration, size_t node_capacity)
+  : threads(threads), exploration(exploration), node_capacity(node_capacity) {}
+
+void MctsPlayer::clear() {
+  root = -1;
+  root_board.reset();
+}
+
+/// <summary>
+/// UCT: average result plus an exploration bonus for rarely visited moves;
+/// threads working below a child count as lost visits there
+/// </summary>
+int32_t MctsPlayer::select_child(int32_t node) {
+  MctsNode& parent = pool()[node];
+  int32_t first = parent.first_child.load(std::memory_order_relaxed);
+  int32_t count = parent.child_count.load(std::memory_order_relaxed);
+  double log_visits = std::log(parent.visits.load(std::memory_order_relaxed) +
+    parent.virtual_loss.load(std::memory_order_relaxed) + 1.0);
+
+  int32_t best = first;
+  double best_value = -1.0;
+  for (int32_t i = first; i < first + count; i++) {
+    MctsNode& child = pool()[i];
+    int32_t visits = child.visits.load(std::memory_order_relaxed) +
+      child.virtual_loss.load(std::memory_order_relaxed);
+    if (visits == 0) {
+      return i; // try every move once
+    }
+    double mean = child.score.load(std::memory_order_relaxed) / (2.0 * visits);
+    double value = mean + exploration * std::sqrt(log_visits / visits);
+    if (value > best_value) {
+      best_value = value;
+      best = i;
+    }
+  }
+  return best;
+}
+
+/// <summary>
+/// adds the children of a leaf; only one thread wins the right to do it,
+/// the others keep playing out from the leaf meanwhile
+/// </summary>
+bool MctsPlayer::expand(int32_t node, MctsThread& thread) {
+  MctsNode& leaf = pool()[node];
+  int32_t expected = LEAF;
+  if (!leaf.state.compare_exchange_strong(expected, EXPANDING)) {
+    return false;
+  }
+  thread.board.generate_moves(thread.moves);
+  if (thread.moves.empty()) {
+    leaf.state.store(TERMINAL, std::memory_order_release);
+    return true;
+  }
+  int32_t count = static_cast<int32_t>(thread.moves.size());
+  int32_t first = pool().allocate(count);
+  if (first < 0) { // pool is full: keep it a leaf and only play out
+    leaf.state.store(LEAF, std::memory_order_release);
+    return false;
+  }
+  for (int32_t i = 0; i < count; i++) {
+    reset_node(pool()[first + i], thread.moves[i], node);
+  }
+  leaf.first_child.store(first, std::memory_order_relaxed);
+  leaf.child_count.store(count, std::memory_order_relaxed);
+  leaf.state.store(EXPANDED, std::memory_order_release);
+  return true;
+}
+
+/// <summary>
+/// plays random moves until the game ends (like the automatic mode) and
+/// takes them back again
+/// </summary>
+int MctsPlayer::playout(MctsThread& thread) const {
+  int result = DRAW;
+  for (int ply = 0; ply < PLAYOUT_LIMIT; ply++) {
+    thread.board.generate_moves(thread.moves);
+    if (thread.moves.empty()) {
+      result = terminal_result(thread.board);
+      break;
+    }
+    Move move = thread.moves[thread.random() % thread.moves.size()];
+    Chesspiece* captured = thread.board.make_move(move);
+    thread.played.push_back(move);
+    thread.taken.push_back(captured);
+    if (captured != nullptr && captured->is_essential()) {
+      result = thread.board.is_whites_turn() ? BLACK_WINS : WHITE_WINS;
+      break;
+    }
+    if (thread.board.is_draw()) {
+      break;
+    }
+  }
+  while (!thread.played.empty()) {
+    thread.board.unmake_move(thread.played.back(), thread.taken.back());
+    thread.played.pop_back();
+    thread.taken.pop_back();
+  }
+  return result;
+}
+
+/// <summary>
+/// one round: select down the tree, expand, play out and back up the result
+/// </summary>
+void MctsPlayer::iterate(MctsThread& thread) {
+  thread.path.clear();
+  thread.captured.clear();
+  thread.path.push_back(root);
+  int32_t node = root;
+  int result;
+  while (true) {
+    MctsNode& current = pool()[node];
+    int32_t state = current.state.load(std::memory_order_acquire);
+    if (state == LEAF && (node == root || current.visits.load(std::memory_order_relaxed) > 0) &&
+      expand(node, thread)) {
+      state = current.state.load(std::memory_order_acquire);
+    }
+    if (state == TERMINAL) {
+      result = terminal_result(thread.board);
+      break;
+    }
+    if (state != EXPANDED) {
+      result = playout(thread);
+      break;
+    }
+
+    node = select_child(node);
+    MctsNode& child = pool()[node];
+    child.virtual_loss.fetch_add(1, std::memory_order_relaxed);
+    Chesspiece* captured = thread.board.make_move(child.move);
+    thread.path.push_back(node);
+    thread.captured.push_back(captured);
+    if (captured != nullptr && captured->is_essential()) {
+      result = thread.board.is_whites_turn() ? BLACK_WINS : WHITE_WINS;
+      break;
+    }
+    if (thread.board.is_draw()) {
+      result = DRAW;
+      break;
+    }
+  }
+
+  for (size_t i = 0; i < thread.path.size(); i++) {
+    MctsNode& visited = pool()[thread.path[i]];
+    visited.visits.fetch_add(1, std::memory_order_relaxed);
+    if (i > 0) {
+      // the move into a node at odd depth was made by the player on turn at the root
+      bool white_moved = (i % 2 == 1) == root_white;
+      visited.virtual_loss.fetch_sub(1, std::memory_order_relaxed);
+      visited.score.fetch_add(white_moved ? result : 2 - result, std::memory_order_relaxed);
+    }
+  }
+  for (size_t i = thread.captured.size(); i-- > 0;) {
+    thread.board.unmake_move(pool()[thread.path[i + 1]].move, thread.captured[i]);
+  }
+}
+
+/// <summary>
+/// copies the subtree below new_root into the spare pool, children kept
+/// next to each other, and makes that pool the active one
+/// </summary>
+void MctsPlayer::compact(int32_t new_root) {
+  NodePool& from = *pools[active];
+  NodePool& to = *pools[1 - active];
+  to.clear();
+  auto copy = [&](int32_t old_index, int32_t new_index, int32_t parent) {
+    MctsNode& old_node = from[old_index];
+    MctsNode& new_node = to[new_index];
+    reset_node(new_node, old_node.move, parent);
+    new_node.visits.store(old_node.visits.load());
+    new_node.score.store(old_node.score.load());
+    int32_t state = old_node.state.load();
+    new_node.state.store(state == EXPANDED ? LEAF : state); // EXPANDED again once children are copied
+  };
+
+  std::vector<std::pair<int32_t, int32_t>> queue;
+  int32_t new_root_index = to.allocate(1);
+  copy(new_root, new_root_index, -1);
+  queue.push_back({ new_root, new_root_index });
+  for (size_t i = 0; i < queue.size(); i++) {
+    int32_t old_index = queue[i].first;
+    int32_t new_index = queue[i].second;
+    if (from[old_index].state.load() != EXPANDED) {
+      continue;
+    }
+    int32_t first = from[old_index].first_child.load();
+    int32_t count = from[old_index].child_count.load();
+    int32_t new_first = to.allocate(count);
+    for (int32_t k = 0; k < count; k++) {
+      copy(first + k, new_first + k, new_index);
+      queue.push_back({ first + k, new_first + k });
+    }
+    to[new_index].first_child.store(new_first);
+    to[new_index].child_count.store(count);
+    to[new_index].state.store(EXPANDED);
+  }
+  active = 1 - active;
+  root = new_root_index;
+}
+
+/// <summary>
+/// keeps the part of the old tree that starts at the new position, if the
+/// new position is one or two plies below the old root
+/// </summary>
+bool MctsPlayer::reuse_tree(const Chessboard& board) {
+  if (root < 0 || root_board == nullptr || root_board->get_size() != board.get_size() ||
+    root_board->get_rules() != board.get_rules()) {
+    return false;
+  }
+  if (root_board->get_hash() == board.get_hash()) {
+    return true;
+  }
+  Chessboard& old_board = *root_board;
+  int32_t found = -1;
+  MctsNode& old_root = pool()[root];
+  if (old_root.state.load() == EXPANDED) {
+    int32_t first = old_root.first_child.load();
+    for (int32_t i = first; i < first + old_root.child_count.load() && found < 0; i++) {
+      Chesspiece* captured = old_board.make_move(pool()[i].move);
+      if (old_board.get_hash() == board.get_hash()) {
+        found = i;
+      }
+      else if (pool()[i].state.load() == EXPANDED) {
+        int32_t grand_first = pool()[i].first_child.load();
+        for (int32_t k = grand_first; k < grand_first + pool()[i].child_count.load() && found < 0; k++) {
+          Chesspiece* grand_captured = old_board.make_move(pool()[k].move);
+          if (old_board.get_hash() == board.get_hash()) {
+            found = k;
+          }
+          old_board.unmake_move(pool()[k].move, grand_captured);
+        }
+      }
+      old_board.unmake_move(pool()[i].move, captured);
+    }
+  }
+  if (found < 0) {
+    return false;
+  }
+  compact(found);
+  root_board.reset(new Chessboard(board));
+  return true;
+}
+
+SearchResult MctsPlayer::search(const Chessboard& board, const SearchLimits& limits, const SearchReport& report) {
+  auto start = std::chrono::steady_clock::now();
+  if (pools[0] == nullptr) {
+    pools[0].reset(new NodePool(node_capacity));
+    pools[1].reset(new NodePool(node_capacity));
+  }
+  if (!reuse_tree(board)) {
+    pool().clear();
+    root = pool().allocate(1);
+    reset_node(pool()[root], { -1, -1 }, -1);
+    root_board.reset(new Chessboard(board));
+  }
+  root_white = board.is_whites_turn();
+
+  std::atomic<uint64_t> playouts{ 0 };
+  TimeBudget budget = plan_time(limits); // no iterations here: only the hard limit counts
+  auto deadline = start + std::chrono::milliseconds(budget.hard);
+  auto work = [&](uint64_t seed) {
+    MctsThread thread(*root_board, seed);
+    for (uint64_t local = 0; !stop_requested.load(std::memory_order_relaxed); local++) {
+      if (limits.nodes > 0 && playouts.load(std::memory_order_relaxed) >= limits.nodes) {
+        break;
+      }
+      if (budget.hard > 0 && local % 64 == 0 && std::chrono::steady_clock::now() >= deadline) {
+        break;
+      }
+      iterate(thread);
+      COUNT_STAT(Counter::SEARCH_NODE);
+      playouts.fetch_add(1, std::memory_order_relaxed);
+    }
+  };
+  {
+    TRACE_SPAN("mcts_search");
+    std::vector<std::thread> helpers;
+    uint64_t seed = static_cast<uint64_t>(start.time_since_epoch().count());
+    for (int i = 1; i < threads; i++) {
+      helpers.emplace_back(work, seed + i * 0x9E3779B97F4A7C15ULL);
+    }
+    work(seed);
+    for (std::thread& helper : helpers) {
+      helper.join();
+    }
+  }
+
+  // the most visited move is the most trusted one
+  SearchResult result;
+  MctsNode& root_node = pool()[root];
+  if (root_node.state.load() == EXPANDED) {
+    int32_t first = root_node.first_child.load();
+    int32_t best = -1;
+    for (int32_t i = first; i < first + root_node.child_count.load(); i++) {
+      if (best < 0 || pool()[i].visits.load() > pool()[best].visits.load()) {
+        best = i;
+      }
+    }
+    int32_t visits = pool()[best].visits.load();
+    double mean = visits > 0 ? pool()[best].score.load() / (2.0 * visits) : 0.5;
+    result.has_move = true;
+    result.best_move = pool()[best].move;
+    result.score = static_cast<int>((mean - 0.5) * 2000);
+    result.depth = 1;
+  }
+  result.nodes = playouts.load();
+  result.time = std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - start).count();
+  if (report && result.has_move) {
+    report(result);
+  }
+  return result;
+}
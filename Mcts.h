@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Chessboard.h"
+#include "Search.h"
+
+struct MctsNode {
+  Move move = { -1, -1 };                // move leading to this node
+  int32_t parent = -1;
+  std::atomic<int32_t> first_child{ -1 }; // children lie next to each other in the pool
+  std::atomic<int32_t> child_count{ 0 };
+  std::atomic<int32_t> state{ 0 };        // see MctsPlayer::LEAF ...
+  std::atomic<int32_t> visits{ 0 };
+  std::atomic<int32_t> virtual_loss{ 0 }; // threads currently below this node
+  std::atomic<int64_t> score{ 0 };        // half points for the player who made the move
+};
+
+struct MctsThread;
+
+/// <summary>
+/// fixed block of nodes handed out lock-free; nodes are never freed one by
+/// one, the whole pool is cleared (or compacted into another pool) at once
+/// </summary>
+class NodePool {
+private:
+  std::vector<MctsNode> nodes;
+  std::atomic<int32_t> used{ 0 };
+
+public:
+  NodePool(size_t capacity) : nodes(capacity) {}
+
+  // index of the first of count new nodes, -1 if the pool is full
+  int32_t allocate(int32_t count);
+  void clear() { used.store(0); }
+  int32_t size() const { return used.load(); }
+  MctsNode& operator[](int32_t index) { return nodes[index]; }
+};
+
+/// <summary>
+/// Monte Carlo tree search (UCT) with random playouts, as in the automatic
+/// game mode. All threads share one tree; a virtual loss on the nodes they
+/// are working below spreads them over different branches. The tree of the
+/// last search is kept and reused when the new position follows from it.
+/// </summary>
+class MctsPlayer {
+private:
+  static constexpr int32_t LEAF = 0;
+  static constexpr int32_t EXPANDING = 1;
+  static constexpr int32_t EXPANDED = 2;
+  static constexpr int32_t TERMINAL = 3;
+
+  int threads;
+  double exploration;
+  size_t node_capacity;
+  std::unique_ptr<NodePool> pools[2]; // the second one is the target of compact()
+  int active = 0;
+  int32_t root = -1;
+  bool root_white = true;
+  std::unique_ptr<Chessboard> root_board;
+  std::atomic<bool> stop_requested{ false };
+
+  NodePool& pool() { return *pools[active]; }
+  bool reuse_tree(const Chessboard& board);
+  void compact(int32_t new_root);
+  int32_t select_child(int32_t node);
+  bool expand(int32_t node, MctsThread& thread);
+  int playout(MctsThread& thread) const;
+  void iterate(MctsThread& thread);
+
+public:
+  // the pools are allocated at the first search
+  MctsPlayer(int threads = 1, double exploration = 1.4, size_t node_capacity = 1 << 19);
+
+  // depth limits are ignored, nodes counts playouts
+  SearchResult search(const Chessboard& board, const SearchLimits& limits, const SearchReport& report = nullptr);
+  void stop() { stop_requested.store(true, std::memory_order_relaxed); }
+  void clear_stop() { stop_requested.store(false, std::memory_order_relaxed); }
+  // forgets the tree, e.g. for a new game
+  void clear();
+  void set_threads(int count) { threads = count; }
+  void set_exploration(double value) { exploration = value; }
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <vector>
+
+// a single step on the board (in the internal row/col representation)
+struct Offset {
+  int row;
+  int col;
+
+  bool operator==(const Offset& other) const {
+    return row == other.row && col == other.col;
+  }
+};
+
+/// <summary>
+/// describes how a chesspiece moves, so move generation and attack maps can
+/// walk the board directly instead of asking can_move for every square
+/// </summary>
+struct MovePattern {
+  std::vector<Offset> leaps;       // jump straight to the target (move or capture)
+  std::vector<Offset> rides;       // repeat the step until something blocks
+  std::vector<Offset> captures;    // jump to the target, but only to capture
+  std::vector<Offset> quiet_leaps; // jump to the target, but never capture
+  bool pawn_push = false;          // one step forward, two from the initial square
+};
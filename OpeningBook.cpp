@@ -0,0 +1,181 @@
+#include "OpeningBook.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include "GameRecord.h"
+#include "Zobrist.h"
+
+constexpr char BOOK_MAGIC[] = "CBK1";
+constexpr size_t BOOK_HEADER_BYTES = 4 + 4 + 8; // magic, reserved, entry count
+
+static_assert(sizeof(BookEntry) == 24, "book entries are mapped directly from the file");
+
+uint64_t book_key(const Chessboard& board) {
+  uint64_t configuration = zobrist_mix((static_cast<uint64_t>(board.get_size()) << 8) |
+    static_cast<uint64_t>(board.get_rules()));
+  for (const PieceDefinition& definition : board.get_fairy_pieces()) {
+    configuration = zobrist_mix(configuration ^ static_cast<unsigned char>(definition.symbol));
+    for (char c : definition.betza) {
+      configuration = zobrist_mix(configuration ^ static_cast<unsigned char>(c));
+    }
+  }
+  return zobrist_mix(board.get_hash() ^ configuration);
+}
+
+// points of the player on turn (2 win, 1 draw, 0 loss)
+static uint32_t points_of(GameState result, bool is_white) {
+  switch (result) {
+  case GameState::BLACK_LOST:
+  case GameState::BLACK_CHECKMATED:
+    return is_white ? 2 : 0;
+  case GameState::WHITE_LOST:
+  case GameState::WHITE_CHECKMATED:
+    return is_white ? 0 : 2;
+  default:
+    return 1;
+  }
+}
+
+void OpeningBookBuilder::add_game(const Chessboard& start, const std::vector<Move>& moves, GameState result) {
+  if (result == GameState::PLAY_ON) {
+    return;
+  }
+  Chessboard board(start);
+  for (size_t ply = 0; ply < moves.size() && ply < BOOK_PLIES; ply++) {
+    const Move& move = moves[ply];
+    MoveCount& count = counts[{ book_key(board), static_cast<uint32_t>(move.from << 16 | move.to) }];
+    count.games++;
+    count.points += points_of(result, board.is_whites_turn());
+    delete board.make_move(move);
+  }
+  game_count++;
+}
+
+ChessError OpeningBookBuilder::add_record(const std::string& path) {
+  GameRecordReader reader(path);
+  if (!reader.is_open()) {
+    return reader.get_error();
+  }
+  Chessboard start(false, reader.get_size(), reader.get_rules(), reader.get_fairy_pieces());
+  std::vector<Move> moves;
+  GameState result;
+  for (uint32_t game = 0; game < reader.get_game_count(); game++) {
+    if (!reader.read_game(game, moves, result)) {
+      return ChessError::DAMAGED_GAME_RECORD;
+    }
+    add_game(start, moves, result);
+  }
+  return ChessError::NONE;
+}
+
+int64_t OpeningBookBuilder::write(const std::string& path, uint32_t min_games) const {
+  std::vector<BookEntry> entries;
+  for (const auto& count : counts) {
+    if (count.second.games >= min_games) {
+      entries.push_back({ count.first.key, static_cast<uint16_t>(count.first.move >> 16),
+        static_cast<uint16_t>(count.first.move & 0xFFFF), count.second.games, count.second.points, 0 });
+    }
+  }
+  std::sort(entries.begin(), entries.end(), [](const BookEntry& a, const BookEntry& b) {
+    if (a.key != b.key) {
+      return a.key < b.key;
+    }
+    return a.from != b.from ? a.from < b.from : a.to < b.to;
+  });
+
+  std::ofstream file(path, std::ios::binary);
+  if (!file) {
+    return -1;
+  }
+  uint32_t reserved = 0;
+  uint64_t entry_count = entries.size();
+  file.write(BOOK_MAGIC, 4);
+  file.write(reinterpret_cast<const char*>(&reserved), sizeof(reserved));
+  file.write(reinterpret_cast<const char*>(&entry_count), sizeof(entry_count));
+  file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(BookEntry));
+  return file ? static_cast<int64_t>(entries.size()) : -1;
+}
+
+bool OpeningBook::open(const std::string& path) {
+  close();
+  error = ChessError::NONE;
+  if (!file.open(path)) {
+    error = ChessError::FILE_NOT_OPENED;
+    return false;
+  }
+  const uint8_t* data = file.get_data();
+  uint64_t count = 0;
+  if (file.get_length() >= BOOK_HEADER_BYTES) {
+    std::memcpy(&count, data + 8, sizeof(count));
+  }
+  if (file.get_length() < BOOK_HEADER_BYTES || !std::equal(data, data + 4, BOOK_MAGIC) ||
+    count > (file.get_length() - BOOK_HEADER_BYTES) / sizeof(BookEntry) ||
+    file.get_length() != BOOK_HEADER_BYTES + count * sizeof(BookEntry)) {
+    close();
+    error = ChessError::NOT_AN_OPENING_BOOK;
+    return false;
+  }
+  // the header is a multiple of 8 bytes and the mapping starts on a page
+  entries = reinterpret_cast<const BookEntry*>(data + BOOK_HEADER_BYTES);
+  entry_count = static_cast<size_t>(count);
+  return true;
+}
+
+std::vector<BookEntry> OpeningBook::lookup(const Chessboard& board) const {
+  std::vector<BookEntry> found;
+  if (!is_open()) {
+    return found;
+  }
+  uint64_t key = book_key(board);
+  const BookEntry* first = std::lower_bound(entries, entries + entry_count, key,
+    [](const BookEntry& entry, uint64_t key) { return entry.key < key; });
+  std::vector<Move> legal;
+  for (const BookEntry* entry = first; entry < entries + entry_count && entry->key == key; entry++) {
+    if (legal.empty()) {
+      board.generate_moves(legal);
+    }
+    if (std::any_of(legal.begin(), legal.end(),
+      [entry](const Move& move) { return move.from == entry->from && move.to == entry->to; })) {
+      found.push_back(*entry);
+    }
+  }
+  return found;
+}
+
+bool OpeningBook::pick_by_frequency(const Chessboard& board, uint64_t random, Move& move) const {
+  std::vector<BookEntry> found = lookup(board);
+  uint64_t total = 0;
+  for (const BookEntry& entry : found) {
+    total += entry.games;
+  }
+  if (total == 0) {
+    return false;
+  }
+  uint64_t pick = random % total;
+  for (const BookEntry& entry : found) {
+    if (pick < entry.games) {
+      move = { entry.from, entry.to };
+      return true;
+    }
+    pick -= entry.games;
+  }
+  return false;
+}
+
+bool OpeningBook::pick_best(const Chessboard& board, Move& move) const {
+  std::vector<BookEntry> found = lookup(board);
+  if (found.empty()) {
+    return false;
+  }
+  // (points + 1) / (2 * games + 2): a move played once is not trusted too much
+  auto better = [](const BookEntry& a, const BookEntry& b) {
+    uint64_t left = (static_cast<uint64_t>(a.points) + 1) * (2 * static_cast<uint64_t>(b.games) + 2);
+    uint64_t right = (static_cast<uint64_t>(b.points) + 1) * (2 * static_cast<uint64_t>(a.games) + 2);
+    return left != right ? left > right : a.games > b.games;
+  };
+  const BookEntry& best = *std::min_element(found.begin(), found.end(), better);
+  move = { best.from, best.to };
+  return true;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Chessboard.h"
+#include "MappedFile.h"
+
+constexpr int BOOK_PLIES = 16;     // moves at the start of every game that go into a book
+constexpr uint32_t BOOK_MIN_GAMES = 2; // moves played less often are left out
+
+// one move of a book position; the entries of a book file are sorted by
+// key, from and to (24 bytes each, in the byte order of the machine that
+// wrote them: little endian on every supported platform)
+struct BookEntry {
+  uint64_t key;     // book_key of the position before the move
+  uint16_t from;    // squares as in Move
+  uint16_t to;
+  uint32_t games;
+  uint32_t points;  // for the player who moved: 2 per won game, 1 per draw
+  uint32_t reserved;
+};
+
+// position key for books: the board's key mixed with its configuration
+// (size, rules, fairy pieces), so one book can hold several configurations
+uint64_t book_key(const Chessboard& board);
+
+/// <summary>
+/// counts the moves of the first BOOK_PLIES plies of many games, e.g. from
+/// game records of self-play, and writes them as a book file
+/// </summary>
+class OpeningBookBuilder {
+private:
+  struct MoveKey {
+    uint64_t key;
+    uint32_t move; // from << 16 | to
+
+    bool operator==(const MoveKey& other) const { return key == other.key && move == other.move; }
+  };
+  struct MoveKeyHash {
+    size_t operator()(const MoveKey& key) const { return static_cast<size_t>(key.key ^ key.move); }
+  };
+  struct MoveCount {
+    uint32_t games = 0;
+    uint32_t points = 0;
+  };
+
+  std::unordered_map<MoveKey, MoveCount, MoveKeyHash> counts;
+  uint64_t game_count = 0;
+
+public:
+  // a game played from start; unfinished games (PLAY_ON) are skipped
+  void add_game(const Chessboard& start, const std::vector<Move>& moves, GameState result);
+  // all games of a game record (up to a damaged one); ChessError::NONE if
+  // the whole record was read
+  ChessError add_record(const std::string& path);
+  uint64_t get_game_count() const { return game_count; }
+  // returns the number of entries written, or -1 if the file cannot be written
+  int64_t write(const std::string& path, uint32_t min_games = BOOK_MIN_GAMES) const;
+};
+
+/// <summary>
+/// a book file mapped into memory; a lookup is a binary search over the
+/// sorted entries, so opening is instant and nothing is copied
+/// </summary>
+class OpeningBook {
+private:
+  MappedFile file;
+  const BookEntry* entries = nullptr;
+  size_t entry_count = 0;
+  ChessError error = ChessError::NONE;
+
+public:
+  bool open(const std::string& path);
+  void close() {
+    file.close();
+    entries = nullptr;
+    entry_count = 0;
+  }
+  bool is_open() const { return entries != nullptr; }
+  // why the last open failed
+  ChessError get_error() const { return error; }
+  size_t get_entry_count() const { return entry_count; }
+
+  // the book moves of the position that are legal on the board (hash
+  // collisions and moves of other rules are filtered out)
+  std::vector<BookEntry> lookup(const Chessboard& board) const;
+  // a book move drawn by how often it was played (random: any random number)
+  bool pick_by_frequency(const Chessboard& board, uint64_t random, Move& move) const;
+  // the book move with the best score (won points, with a prior of one draw)
+  bool pick_best(const Chessboard& board, Move& move) const;
+};
@@ -0,0 +1,42 @@
+#include "PatternTables.h"
+
+LeapTable PatternTables::compile(const std::vector<Offset>& steps) const {
+  LeapTable table;
+  table.first.reserve(size * size + 1);
+  for (int col = 0; col < size; col++) {
+    for (int row = 0; row < size; row++) {
+      table.first.push_back((int)table.targets.size());
+      for (const Offset& step : steps) {
+        int r = row + step.row, c = col + step.col;
+        if (r >= 0 && r < size && c >= 0 && c < size) {
+          table.targets.push_back(c * size + r);
+        }
+      }
+    }
+  }
+  table.first.push_back((int)table.targets.size());
+  return table;
+}
+
+CompiledPattern PatternTables::compile(const MovePattern& pattern) const {
+  return { &pattern, compile(pattern.leaps), compile(pattern.captures), compile(pattern.quiet_leaps) };
+}
+
+void PatternTables::add(const MovePattern& pattern) {
+  if (get(pattern) == nullptr) {
+    compiled.push_back(compile(pattern));
+  }
+}
+
+/// <summary>
+/// gets the tables of a pattern that was added before (there are only a
+/// handful of different pieces, so a linear search is the fastest lookup)
+/// </summary>
+const CompiledPattern* PatternTables::get(const MovePattern& pattern) const {
+  for (const CompiledPattern& known : compiled) {
+    if (known.pattern == &pattern) {
+      return &known;
+    }
+  }
+  return nullptr;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+
+#include "MovePattern.h"
+
+// target squares of a set of leaps for every square of the board; the targets
+// of square s are targets[first[s]] .. targets[first[s + 1] - 1]
+struct LeapTable {
+  std::vector<int> first;
+  std::vector<int> targets;
+};
+
+// the leaps of a pattern resolved to on-board target squares
+struct CompiledPattern {
+  const MovePattern* pattern;
+  LeapTable leaps;
+  LeapTable captures;
+  LeapTable quiet_leaps;
+};
+
+/// <summary>
+/// precomputed leap targets for every movement pattern used on a board, so
+/// move generation never has to check leaps against the board edges
+/// </summary>
+class PatternTables {
+private:
+  int size;
+  std::vector<CompiledPattern> compiled;
+
+  LeapTable compile(const std::vector<Offset>& steps) const;
+
+public:
+  PatternTables(int size) : size(size) {}
+
+  // the tables of a pattern, without keeping them
+  CompiledPattern compile(const MovePattern& pattern) const;
+  void add(const MovePattern& pattern);
+  // nullptr if the pattern was not added
+  const CompiledPattern* get(const MovePattern& pattern) const;
+};
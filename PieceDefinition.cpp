@@ -0,0 +1,158 @@
+#include "PieceDefinition.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+/// <summary>
+/// the basic Betza leapers: a (row, col) jump that can be mirrored and swapped
+/// </summary>
+static bool atom_jump(char atom, Offset& jump) {
+  switch (atom) {
+  case 'W': jump = { 0, 1 }; return true; // wazir
+  case 'F': jump = { 1, 1 }; return true; // ferz
+  case 'D': jump = { 0, 2 }; return true; // dabbaba (like the Hopper)
+  case 'N': jump = { 1, 2 }; return true; // knight
+  case 'A': jump = { 2, 2 }; return true; // alfil
+  case 'H': jump = { 0, 3 }; return true; // threeleaper
+  case 'C': jump = { 1, 3 }; return true; // camel
+  case 'Z': jump = { 2, 3 }; return true; // zebra
+  case 'G': jump = { 3, 3 }; return true; // tripper
+  default: return false;
+  }
+}
+
+static void add_unique(std::vector<Offset>& steps, const Offset& step) {
+  if (std::find(steps.begin(), steps.end(), step) == steps.end()) {
+    steps.push_back(step);
+  }
+}
+
+/// <summary>
+/// adds all (up to eight) symmetric variants of the jump
+/// </summary>
+static void add_symmetric(std::vector<Offset>& steps, Offset jump) {
+  for (int swapped = 0; swapped < 2; swapped++) {
+    for (int row_sign = -1; row_sign <= 1; row_sign += 2) {
+      for (int col_sign = -1; col_sign <= 1; col_sign += 2) {
+        add_unique(steps, { row_sign * jump.row, col_sign * jump.col });
+      }
+    }
+    std::swap(jump.row, jump.col);
+  }
+}
+
+bool parse_betza(const std::string& betza, MovePattern& pattern, std::string& error) {
+  pattern = MovePattern();
+  size_t i = 0;
+  while (i < betza.size()) {
+    bool move_only = false;
+    bool capture_only = false;
+    while (i < betza.size() && (betza[i] == 'm' || betza[i] == 'c')) {
+      move_only |= betza[i] == 'm';
+      capture_only |= betza[i] == 'c';
+      i++;
+    }
+    if (move_only && capture_only) { // "mc" means both, like no modifier at all
+      move_only = capture_only = false;
+    }
+    if (i == betza.size()) {
+      error = "modifier without a piece in '" + betza + "'";
+      return false;
+    }
+
+    // shorthands of the orthodox pieces
+    char atom = betza[i++];
+    std::string atoms(1, atom);
+    bool rider = false;
+    switch (atom) {
+    case 'K': atoms = "WF"; break;
+    case 'R': atoms = "W"; rider = true; break;
+    case 'B': atoms = "F"; rider = true; break;
+    case 'Q': atoms = "WF"; rider = true; break;
+    default:
+      // a doubled atom rides in its direction (eg "NN" is the nightrider)
+      if (i < betza.size() && betza[i] == atom) {
+        rider = true;
+        i++;
+      }
+    }
+    if (rider && (move_only || capture_only)) {
+      error = "move/capture modifiers are only supported for leapers in '" + betza + "'";
+      return false;
+    }
+
+    for (char part : atoms) {
+      Offset jump;
+      if (!atom_jump(part, jump)) {
+        error = std::string("unknown piece '") + atom + "' in '" + betza + "'";
+        return false;
+      }
+      std::vector<Offset>& target = rider ? pattern.rides
+        : move_only ? pattern.quiet_leaps
+        : capture_only ? pattern.captures
+        : pattern.leaps;
+      add_symmetric(target, jump);
+    }
+  }
+  if (pattern.leaps.empty() && pattern.rides.empty() &&
+    pattern.captures.empty() && pattern.quiet_leaps.empty()) {
+    error = "empty movement";
+    return false;
+  }
+  return true;
+}
+
+bool load_piece_definitions(const std::string& path, std::vector<PieceDefinition>& definitions,
+  std::string& error) {
+  std::ifstream file(path);
+  if (!file) {
+    error = "Could not open piece definitions '" + path + "'";
+    return false;
+  }
+
+  std::string line;
+  int line_number = 0;
+  while (std::getline(file, line)) {
+    line_number++;
+    line = line.substr(0, line.find('#'));
+    std::istringstream fields(line);
+    std::string symbol;
+    PieceDefinition definition;
+    if (!(fields >> symbol)) {
+      continue; // empty or comment line
+    }
+    std::string location = path + ':' + std::to_string(line_number) + ": ";
+    if (!(fields >> definition.betza)) {
+      error = location + "missing movement of '" + symbol + "'";
+      return false;
+    }
+
+    definition.symbol = symbol[0];
+    if (symbol.size() != 1 || definition.symbol < 'A' || definition.symbol > 'Z' ||
+      std::string("KQRBNP").find(definition.symbol) != std::string::npos) {
+      error = location + "'" + symbol + "' is no free symbol (single upper case letter except K, Q, R, B, N and P)";
+      return false;
+    }
+    for (const PieceDefinition& other : definitions) {
+      if (other.symbol == definition.symbol) {
+        error = location + "'" + symbol + "' is defined twice";
+        return false;
+      }
+    }
+
+    MovePattern pattern;
+    if (!parse_betza(definition.betza, pattern, error)) {
+      error = location + error;
+      return false;
+    }
+    definition.pattern = std::make_shared<const MovePattern>(pattern);
+
+    std::string square;
+    while (fields >> square) {
+      definition.start_squares.push_back(square);
+    }
+    definitions.push_back(definition);
+  }
+  return true;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MovePattern.h"
+
+/// <summary>
+/// a chesspiece described by data instead of code, e.g. "U ND C3" is a piece
+/// printed as 'U' that moves like a knight or a dabbaba (two squares
+/// orthogonally) and starts on C3 (black gets the mirrored square)
+/// </summary>
+struct PieceDefinition {
+  char symbol;
+  std::string betza;
+  std::shared_ptr<const MovePattern> pattern;
+  std::vector<std::string> start_squares; // user notation for white, eg "C3"
+};
+
+// compiles a Betza movement descriptor (eg "N", "BN", "mWcF", "NN") into a pattern
+bool parse_betza(const std::string& betza, MovePattern& pattern, std::string& error);
+
+// reads "symbol betza [squares...]" lines ('#' starts a comment); on failure
+// error tells what is wrong (with the file and line)
+bool load_piece_definitions(const std::string& path, std::vector<PieceDefinition>& definitions,
+  std::string& error);
@@ -0,0 +1,45 @@
+#include "Ponder.h"
+
+// a quick search is enough to guess what the human will play
+constexpr int GUESS_DEPTH = 4;
+
+void Ponderer::start(const Chessboard& board) {
+  cancel();
+  position.reset(new Chessboard(board));
+  has_guess = false;
+  result = SearchResult();
+  search.clear_stop();
+  worker = std::thread([this]() {
+    SearchLimits guess_limits;
+    guess_limits.depth = GUESS_DEPTH;
+    SearchResult guess = search.run(*position, guess_limits);
+    if (guess.depth == 0 || !position->play_move(guess.best_move)) {
+      return; // stopped before there was a guess (or nothing to play)
+    }
+    expected_hash = position->get_hash();
+    has_guess = true;
+    result = search.run(*position, SearchLimits());
+  });
+}
+
+bool Ponderer::finish(const Chessboard& board, SearchResult& reply) {
+  if (!worker.joinable()) {
+    return false;
+  }
+  search.stop();
+  worker.join();
+  search.clear_stop();
+  if (!has_guess || expected_hash != board.get_hash() || !result.has_move) {
+    return false;
+  }
+  reply = result;
+  return true;
+}
+
+void Ponderer::cancel() {
+  if (worker.joinable()) {
+    search.stop();
+    worker.join();
+    search.clear_stop();
+  }
+}
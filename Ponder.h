@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include "Chessboard.h"
+#include "Search.h"
+
+/// <summary>
+/// thinks on the opponent's time: while the human is typing, the engine
+/// guesses the human move and searches its own reply on a copy of the board.
+/// The shared Search keeps its transposition table, so even a wrong guess
+/// leaves the table warm for the real reply.
+/// </summary>
+class Ponderer {
+private:
+  Search& search;
+  std::thread worker;
+  std::unique_ptr<Chessboard> position;
+  bool has_guess = false;
+  uint64_t expected_hash = 0; // position after the guessed move
+  SearchResult result;
+
+public:
+  Ponderer(Search& search) : search(search) {}
+  ~Ponderer() { cancel(); }
+
+  // starts pondering; the human is on turn on the given board
+  void start(const Chessboard& board);
+  // stops pondering; true if the guessed move was played (result is the
+  // reply found so far), false if the engine has to search from scratch
+  bool finish(const Chessboard& board, SearchResult& reply);
+  void cancel();
+};
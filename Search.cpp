@@ -0,0 +1,339 @@
+#include "Search.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "Stats.h"
+#include "Trace.h"
+
+constexpr int INFINITE_SCORE = MATE_SCORE + 1;
+constexpr int64_t MOVE_OVERHEAD = 20;   // milliseconds kept for sending the move
+constexpr int64_t EMERGENCY_TIME = 100; // less on the clock: depth 1 only
+constexpr int EXPECTED_MOVES = 30;      // moves still to play when the game has no time control
+
+int piece_value(const Chesspiece& cp) {
+  if (cp.is_essential()) {
+    return 0; // losing the king ends the game, it has no material value
+  }
+  switch (cp.get_letter()) {
+  case 'P': return 100;
+  case 'N': return 300;
+  case 'B': return 330;
+  case 'R': return 500;
+  case 'Q': return 900;
+  }
+  // rough estimate for everything else: a knight is worth 8 leaps
+  const MovePattern& pattern = cp.get_pattern();
+  return static_cast<int>(pattern.leaps.size()) * 37 +
+    static_cast<int>(pattern.captures.size() + pattern.quiet_leaps.size()) * 18 +
+    static_cast<int>(pattern.rides.size()) * 100;
+}
+
+std::string score_to_string(int score) {
+  if (std::abs(score) > MATE_SCORE - MAX_PLY) {
+    int plies = MATE_SCORE - std::abs(score);
+    int moves = (plies + 1) / 2;
+    return "mate " + std::to_string(score > 0 ? moves : -moves);
+  }
+  return "cp " + std::to_string(score);
+}
+
+/// <summary>
+/// spreads the clock over the moves still to come (plus most of the
+/// increment); a single move may take up to four shares if the search is
+/// in the middle of an iteration, but never the time that is left
+/// </summary>
+TimeBudget plan_time(const SearchLimits& limits) {
+  TimeBudget budget;
+  if (limits.move_time > 0) {
+    budget.soft = budget.hard = limits.move_time;
+  }
+  if (limits.clock > 0) {
+    int64_t usable = std::max<int64_t>(limits.clock - MOVE_OVERHEAD, 1);
+    int moves = limits.moves_to_go > 0 ? limits.moves_to_go : EXPECTED_MOVES;
+    int64_t share = std::min(usable / moves + limits.increment * 3 / 4, usable);
+    int64_t soft = std::max<int64_t>(share, 1);
+    int64_t hard = std::min(4 * share, usable);
+    if (usable < EMERGENCY_TIME) {
+      budget.emergency = true;
+      soft = 1;
+      hard = std::max<int64_t>(usable / 2, 1);
+    }
+    budget.soft = budget.soft > 0 ? std::min(budget.soft, soft) : soft;
+    budget.hard = budget.hard > 0 ? std::min(budget.hard, hard) : hard;
+  }
+  return budget;
+}
+
+/// <summary>
+/// small bonus for standing near the center of the board
+/// </summary>
+static int square_bonus(int square, int size) {
+  int row_distance = std::abs(2 * (square % size) - (size - 1));
+  int col_distance = std::abs(2 * (square / size) - (size - 1));
+  return size - std::max(row_distance, col_distance);
+}
+
+static int piece_score(const Chesspiece& cp, int square, int size) {
+  if (cp.is_essential()) {
+    return 0;
+  }
+  return piece_value(cp) + square_bonus(square, size);
+}
+
+// material and position of all figures from the view of white
+static int white_material(const Chessboard& board) {
+  int size = board.get_size();
+  int material = 0;
+  for (int square : board.get_piece_squares(true)) {
+    material += piece_score(*board.piece_at(square), square, size);
+  }
+  for (int square : board.get_piece_squares(false)) {
+    material -= piece_score(*board.piece_at(square), square, size);
+  }
+  return material;
+}
+
+// change of white_material caused by the move (computed before it is made)
+static int material_change(const Chessboard& board, const Move& move) {
+  int size = board.get_size();
+  const Chesspiece* moving = board.piece_at(move.from);
+  const Chesspiece* target = board.piece_at(move.to);
+  int change = piece_score(*moving, move.to, size) - piece_score(*moving, move.from, size);
+  if (target != nullptr) {
+    change += piece_score(*target, move.to, size);
+  }
+  return moving->is_white() ? change : -change;
+}
+
+// mate scores are stored relative to the node, not to the root
+static int to_table(int score, int ply) {
+  if (score > MATE_SCORE - MAX_PLY) {
+    return score + ply;
+  }
+  if (score < -MATE_SCORE + MAX_PLY) {
+    return score - ply;
+  }
+  return score;
+}
+
+static int from_table(int score, int ply) {
+  if (score > MATE_SCORE - MAX_PLY) {
+    return score - ply;
+  }
+  if (score < -MATE_SCORE + MAX_PLY) {
+    return score + ply;
+  }
+  return score;
+}
+
+bool Search::should_stop() {
+  if (aborted) {
+    return true;
+  }
+  // reading the clock is expensive, so only every 1024 nodes
+  if (stop_requested.load(std::memory_order_relaxed) ||
+    (node_limit > 0 && nodes >= node_limit) ||
+    (has_deadline && (nodes & 1023) == 0 && std::chrono::steady_clock::now() >= deadline)) {
+    aborted = true;
+  }
+  return aborted;
+}
+
+int Search::evaluate(const Chessboard& board, int material) const {
+  return board.is_whites_turn() ? material : -material;
+}
+
+/// <summary>
+/// best move of the table first, then captures of valuable figures by cheap ones
+/// </summary>
+void Search::order_moves(const Chessboard& board, std::vector<Move>& moves, const Move& first) const {
+  auto key = [&](const Move& move) {
+    if (move.from == first.from && move.to == first.to) {
+      return INFINITE_SCORE;
+    }
+    const Chesspiece* target = board.piece_at(move.to);
+    if (target == nullptr) {
+      return 0;
+    }
+    if (target->is_essential()) {
+      return MATE_SCORE;
+    }
+    return 10 * piece_value(*target) - piece_value(*board.piece_at(move.from)) + 10000;
+  };
+  std::stable_sort(moves.begin(), moves.end(),
+    [&](const Move& a, const Move& b) { return key(a) > key(b); });
+}
+
+int Search::negamax(Chessboard& board, int depth, int ply, int alpha, int beta, int material) {
+  if (depth <= 0 || ply >= MAX_PLY - 1) {
+    return quiescence(board, ply, alpha, beta, material);
+  }
+  COUNT_STAT(Counter::SEARCH_NODE);
+  nodes++;
+  if (should_stop()) {
+    return 0;
+  }
+  // already one repetition is a draw: whoever could avoid it would have
+  if (ply > 0 && (board.repetitions() > 0 || board.no_capture_limit_reached())) {
+    return 0;
+  }
+
+  int original_alpha = alpha;
+  Move table_move = { -1, -1 };
+  TableEntry entry;
+  if (table.probe(board.get_hash(), entry)) {
+    COUNT_STAT(Counter::HASH_HIT);
+    table_move = entry.move;
+    int score = from_table(entry.score, ply);
+    if (ply > 0 && entry.depth >= depth &&
+      (entry.bound == Bound::EXACT ||
+        (entry.bound == Bound::LOWER && score >= beta) ||
+        (entry.bound == Bound::UPPER && score <= alpha))) {
+      return score;
+    }
+  }
+
+  std::vector<Move>& moves = move_stack[ply];
+  board.generate_moves(moves);
+  if (moves.empty()) {
+    bool mated = board.get_rules() == RuleSet::CHECKMATE && board.in_check();
+    return mated ? -MATE_SCORE + ply : 0;
+  }
+  order_moves(board, moves, table_move);
+
+  int best_score = -INFINITE_SCORE;
+  Move best_move = moves.front();
+  for (const Move& move : moves) {
+    int score;
+    const Chesspiece* target = board.piece_at(move.to);
+    if (target != nullptr && target->is_essential()) {
+      score = MATE_SCORE - ply - 1; // capturing the king wins at once
+    }
+    else {
+      int change = material_change(board, move);
+      Chesspiece* captured = board.make_move(move);
+      score = -negamax(board, depth - 1, ply + 1, -beta, -alpha, material + change);
+      board.unmake_move(move, captured);
+    }
+    if (aborted) {
+      return 0;
+    }
+    if (score > best_score) {
+      best_score = score;
+      best_move = move;
+      if (ply == 0) {
+        root_best = move;
+      }
+    }
+    alpha = std::max(alpha, score);
+    if (alpha >= beta) {
+      break;
+    }
+  }
+
+  Bound bound = best_score <= original_alpha ? Bound::UPPER
+    : best_score >= beta ? Bound::LOWER
+    : Bound::EXACT;
+  table.store(board.get_hash(), depth, to_table(best_score, ply), bound, best_move);
+  return best_score;
+}
+
+int Search::quiescence(Chessboard& board, int ply, int alpha, int beta, int material) {
+  COUNT_STAT(Counter::SEARCH_NODE);
+  nodes++;
+  if (should_stop()) {
+    return 0;
+  }
+  int stand_pat = evaluate(board, material);
+  if (stand_pat >= beta || ply >= MAX_PLY - 1) {
+    return stand_pat;
+  }
+  alpha = std::max(alpha, stand_pat);
+
+  // only captures: the position has to calm down before it is evaluated
+  std::vector<Move>& moves = move_stack[ply];
+  board.generate_moves(moves);
+  moves.erase(std::remove_if(moves.begin(), moves.end(),
+    [&](const Move& move) { return board.piece_at(move.to) == nullptr; }), moves.end());
+  order_moves(board, moves, { -1, -1 });
+
+  for (const Move& move : moves) {
+    int score;
+    if (board.piece_at(move.to)->is_essential()) {
+      score = MATE_SCORE - ply - 1;
+    }
+    else {
+      int change = material_change(board, move);
+      Chesspiece* captured = board.make_move(move);
+      score = -quiescence(board, ply + 1, -beta, -alpha, material + change);
+      board.unmake_move(move, captured);
+    }
+    if (aborted) {
+      return 0;
+    }
+    if (score >= beta) {
+      return score;
+    }
+    alpha = std::max(alpha, score);
+  }
+  return alpha;
+}
+
+/// <summary>
+/// searches the position until the limits are reached or stop() is called;
+/// the board is changed during the search but restored at the end
+/// </summary>
+SearchResult Search::run(Chessboard& board, const SearchLimits& limits, const SearchReport& report) {
+  start = std::chrono::steady_clock::now();
+  TimeBudget budget = plan_time(limits);
+  has_deadline = budget.hard > 0;
+  deadline = start + std::chrono::milliseconds(budget.hard);
+  node_limit = limits.nodes;
+  nodes = 0;
+  aborted = false;
+
+  SearchResult result;
+  std::vector<Move> root_moves;
+  board.generate_moves(root_moves);
+  if (root_moves.empty()) {
+    return result;
+  }
+  // something to play even if the first iteration is cut short
+  result.has_move = true;
+  result.best_move = root_moves.front();
+
+  int material = white_material(board);
+  int max_depth = budget.emergency ? 1 : limits.depth;
+  for (int depth = 1; depth <= max_depth; depth++) {
+    TRACE_SPAN("search_iteration");
+    root_best = result.best_move;
+    int score = negamax(board, depth, 0, -INFINITE_SCORE, INFINITE_SCORE, material);
+    if (aborted) {
+      if (depth == 1) {
+        result.best_move = root_best; // the best of the moves searched before the deadline
+      }
+      break;
+    }
+    result.best_move = root_best;
+    result.score = score;
+    result.depth = depth;
+    result.nodes = nodes;
+    result.time = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start).count();
+    if (report) {
+      report(result);
+    }
+    if (std::abs(score) > MATE_SCORE - MAX_PLY) {
+      break; // a forced mate will not get any better
+    }
+    // the next iteration usually takes longer than all before it together
+    if (budget.soft > 0 && 2 * result.time >= budget.soft) {
+      break;
+    }
+  }
+  result.nodes = nodes;
+  result.time = std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - start).count();
+  return result;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "Chessboard.h"
+#include "TranspositionTable.h"
+
+// scores are in centipawns from the view of the player on turn
+constexpr int MATE_SCORE = 1000000;
+constexpr int MAX_PLY = 128;
+
+struct SearchLimits {
+  int depth = MAX_PLY - 1;
+  uint64_t nodes = 0;    // 0: no limit
+  int64_t move_time = 0; // milliseconds, 0: no limit
+  int64_t clock = 0;     // milliseconds left for the player on turn, 0: no clock
+  int64_t increment = 0; // milliseconds added to the clock after the move
+  int moves_to_go = 0;   // moves until the clock is filled up again, 0: rest of the game
+};
+
+// how long a search may take (milliseconds, 0: no limit): after soft no
+// new iteration is started, at hard the search is stopped in the middle
+struct TimeBudget {
+  int64_t soft = 0;
+  int64_t hard = 0;
+  bool emergency = false; // almost no time left: only the quickest answer
+};
+
+// the time of one move from a fixed move time and/or the game clock
+TimeBudget plan_time(const SearchLimits& limits);
+
+struct SearchResult {
+  bool has_move = false;
+  Move best_move = { -1, -1 };
+  int score = 0;
+  int depth = 0;       // last completed iteration
+  uint64_t nodes = 0;
+  int64_t time = 0;    // milliseconds
+};
+
+// called after every completed iteration of the iterative deepening
+using SearchReport = std::function<void(const SearchResult&)>;
+
+// "cp 35" or "mate 3" (moves, negative when the player on turn gets mated)
+std::string score_to_string(int score);
+
+// value of a figure in centipawns (fairy pieces are rated by their pattern)
+int piece_value(const Chesspiece& cp);
+
+/// <summary>
+/// alpha-beta search with iterative deepening, quiescence search and a
+/// transposition table; stop() may be called from any thread
+/// </summary>
+class Search {
+private:
+  TranspositionTable table;
+  std::atomic<bool> stop_requested{ false };
+  std::vector<std::vector<Move>> move_stack; // one move list per ply
+  std::chrono::steady_clock::time_point start;
+  std::chrono::steady_clock::time_point deadline;
+  bool has_deadline = false;
+  uint64_t node_limit = 0;
+  uint64_t nodes = 0;
+  bool aborted = false;
+  Move root_best = { -1, -1 };
+
+  bool should_stop();
+  int evaluate(const Chessboard& board, int material) const;
+  void order_moves(const Chessboard& board, std::vector<Move>& moves, const Move& first) const;
+  int negamax(Chessboard& board, int depth, int ply, int alpha, int beta, int material);
+  int quiescence(Chessboard& board, int ply, int alpha, int beta, int material);
+
+public:
+  Search(size_t table_megabytes = 16) : table(table_megabytes), move_stack(MAX_PLY + 1) {}
+
+  SearchResult run(Chessboard& board, const SearchLimits& limits, const SearchReport& report = nullptr);
+  // stop() stays in effect until clear_stop(), so it cannot get lost when it
+  // arrives before the searching thread got to run()
+  void stop() { stop_requested.store(true, std::memory_order_relaxed); }
+  void clear_stop() { stop_requested.store(false, std::memory_order_relaxed); }
+  void clear() { table.clear(); }
+};
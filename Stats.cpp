@@ -0,0 +1,99 @@
+#include "Stats.h"
+
+#include <atomic>
+
+/// <summary>
+/// the counters of one thread; only this thread writes them, collect_stats
+/// reads them from other threads (hence atomics, but without locked adds)
+/// </summary>
+struct ThreadCounters {
+  char padding[64]; // keep the counters off the cache line of other data
+  std::atomic<uint64_t> values[NUMBER_OF_COUNTERS];
+  ThreadCounters* next;
+};
+
+// blocks are never freed, so counts of finished threads are kept
+static std::atomic<ThreadCounters*> all_counters{ nullptr };
+static thread_local ThreadCounters* local_counters = nullptr;
+
+static const char* counter_names[NUMBER_OF_COUNTERS] = {
+  "can_move_king",
+  "can_move_queen",
+  "can_move_bishop",
+  "can_move_rook",
+  "can_move_knight",
+  "can_move_pawn",
+  "can_move_hopper",
+  "can_move_quadrilateral",
+  "can_move_fairy",
+  "can_pass_over",
+  "game_over_scan",
+  "rejected_draw",
+  "allocation",
+  "search_node",
+  "hash_hit",
+};
+
+static ThreadCounters* register_thread() {
+  // calloc instead of new: operator new is counted itself
+  void* memory = std::calloc(1, sizeof(ThreadCounters));
+  if (memory == nullptr) {
+    std::abort();
+  }
+  ThreadCounters* counters = new (memory) ThreadCounters();
+  counters->next = all_counters.load();
+  while (!all_counters.compare_exchange_weak(counters->next, counters)) {
+  }
+  return counters;
+}
+
+void stats_add(Counter counter, uint64_t amount) {
+  ThreadCounters* counters = local_counters;
+  if (counters == nullptr) {
+    counters = local_counters = register_thread();
+  }
+  std::atomic<uint64_t>& value = counters->values[static_cast<int>(counter)];
+  value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+StatsSnapshot collect_stats() {
+  StatsSnapshot snapshot;
+  for (ThreadCounters* counters = all_counters.load(); counters != nullptr; counters = counters->next) {
+    for (int i = 0; i < NUMBER_OF_COUNTERS; i++) {
+      snapshot.values[i] += counters->values[i].load(std::memory_order_relaxed);
+    }
+  }
+  return snapshot;
+}
+
+/// <summary>
+/// sets all counters to zero (only exact while no other thread is counting)
+/// </summary>
+void reset_stats() {
+  for (ThreadCounters* counters = all_counters.load(); counters != nullptr; counters = counters->next) {
+    for (int i = 0; i < NUMBER_OF_COUNTERS; i++) {
+      counters->values[i].store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+const char* counter_name(Counter counter) {
+  return counter_names[static_cast<int>(counter)];
+}
+
+bool stats_enabled() {
+#ifdef CHESS_STATS
+  return true;
+#else
+  return false;
+#endif
+}
+
+void write_stats_json(std::ostream& out) {
+  StatsSnapshot snapshot = collect_stats();
+  out << "{\"enabled\": " << (stats_enabled() ? "true" : "false") << ", \"counters\": {";
+  for (int i = 0; i < NUMBER_OF_COUNTERS; i++) {
+    out << (i > 0 ? ", " : "") << '"' << counter_names[i] << "\": " << snapshot.values[i];
+  }
+  out << "}}" << std::endl;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+// define CHESS_STATS (eg in the project settings) to count what happens in the
+// hot paths; without it every COUNT_STAT compiles to nothing
+#ifdef CHESS_STATS
+#define COUNT_STAT(counter) stats_add(counter)
+#else
+#define COUNT_STAT(counter) ((void)0)
+#endif
+
+enum class Counter {
+  CAN_MOVE_KING,
+  CAN_MOVE_QUEEN,
+  CAN_MOVE_BISHOP,
+  CAN_MOVE_ROOK,
+  CAN_MOVE_KNIGHT,
+  CAN_MOVE_PAWN,
+  CAN_MOVE_HOPPER,
+  CAN_MOVE_QUADRILATERAL,
+  CAN_MOVE_FAIRY,
+  CAN_PASS_OVER,
+  GAME_OVER_SCAN,
+  REJECTED_DRAW,  // random figure in play_random_moves that could not move
+  ALLOCATION,     // calls of operator new (counted by StatsAllocator.cpp, linked into chess only)
+  SEARCH_NODE,
+  HASH_HIT,
+  NUMBER_OF_COUNTERS
+};
+
+constexpr int NUMBER_OF_COUNTERS = static_cast<int>(Counter::NUMBER_OF_COUNTERS);
+
+struct StatsSnapshot {
+  uint64_t values[NUMBER_OF_COUNTERS] = {};
+
+  uint64_t operator[](Counter counter) const { return values[static_cast<int>(counter)]; }
+};
+
+// counts on the calling thread only (no locking, no shared cache lines)
+void stats_add(Counter counter, uint64_t amount = 1);
+
+// sums the counters of all threads (running and finished ones)
+StatsSnapshot collect_stats();
+void reset_stats();
+const char* counter_name(Counter counter);
+bool stats_enabled();
+
+// writes the collected counters as a JSON object
+void write_stats_json(std::ostream& out);
@@ -0,0 +1,26 @@
+#include "Stats.h"
+
+#include <cstdlib>
+#include <new>
+
+// the replaced global operator new counts every allocation of the program;
+// it is part of the chess executable only, programs using the library keep
+// their own allocator
+#ifdef CHESS_STATS
+void* operator new(std::size_t size) {
+  stats_add(Counter::ALLOCATION);
+  void* memory = std::malloc(size == 0 ? 1 : size);
+  if (memory == nullptr) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void operator delete(void* memory) noexcept {
+  std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+  std::free(memory);
+}
+#endif
@@ -0,0 +1,93 @@
+#include "Trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+
+// number of spans kept per thread (older ones are overwritten)
+constexpr uint32_t RING_SIZE = 1 << 16;
+
+struct TraceEvent {
+  const char* name;
+  uint64_t start;
+  uint64_t end;
+};
+
+/// <summary>
+/// ring buffer of one thread: only the owning thread writes, the dump reads
+/// up to the published head
+/// </summary>
+struct TraceRing {
+  TraceEvent events[RING_SIZE];
+  std::atomic<uint64_t> head{ 0 };
+  int thread_id = 0;
+  TraceRing* next = nullptr;
+};
+
+static std::atomic<bool> enabled{ false };
+static std::atomic<TraceRing*> all_rings{ nullptr };
+static std::atomic<int> next_thread_id{ 1 };
+static thread_local TraceRing* local_ring = nullptr;
+static const std::chrono::steady_clock::time_point trace_epoch = std::chrono::steady_clock::now();
+
+void set_tracing(bool on) {
+  enabled.store(on, std::memory_order_relaxed);
+}
+
+bool tracing_enabled() {
+  return enabled.load(std::memory_order_relaxed);
+}
+
+bool tracing_compiled() {
+#ifdef CHESS_TRACE
+  return true;
+#else
+  return false;
+#endif
+}
+
+uint64_t trace_now() {
+  auto elapsed = std::chrono::steady_clock::now() - trace_epoch;
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() + 1;
+}
+
+static TraceRing* register_thread() {
+  TraceRing* ring = new TraceRing(); // never freed: the dump may happen after the thread ended
+  ring->thread_id = next_thread_id.fetch_add(1);
+  ring->next = all_rings.load();
+  while (!all_rings.compare_exchange_weak(ring->next, ring)) {
+  }
+  return ring;
+}
+
+void trace_record(const char* name, uint64_t start, uint64_t end) {
+  TraceRing* ring = local_ring;
+  if (ring == nullptr) {
+    ring = local_ring = register_thread();
+  }
+  uint64_t head = ring->head.load(std::memory_order_relaxed);
+  ring->events[head % RING_SIZE] = { name, start, end };
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+void write_trace_json(std::ostream& out) {
+  std::ios::fmtflags flags = out.flags();
+  std::streamsize precision = out.precision();
+  out << std::fixed << std::setprecision(3) << "{\"traceEvents\": [";
+  bool first = true;
+  for (TraceRing* ring = all_rings.load(); ring != nullptr; ring = ring->next) {
+    uint64_t head = ring->head.load(std::memory_order_acquire);
+    uint64_t oldest = head > RING_SIZE ? head - RING_SIZE : 0;
+    for (uint64_t i = oldest; i < head; i++) {
+      const TraceEvent& event = ring->events[i % RING_SIZE];
+      // timestamps are in microseconds
+      out << (first ? "\n" : ",\n") << "{\"name\": \"" << event.name << "\", \"ph\": \"X\", \"ts\": "
+        << event.start / 1000.0 << ", \"dur\": " << (event.end - event.start) / 1000.0
+        << ", \"pid\": 1, \"tid\": " << ring->thread_id << '}';
+      first = false;
+    }
+  }
+  out << "\n], \"displayTimeUnit\": \"ns\"}" << std::endl;
+  out.flags(flags);
+  out.precision(precision);
+}
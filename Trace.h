@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+// define CHESS_TRACE to be able to record a timeline; without it every
+// TRACE_SPAN compiles to nothing, with it a disabled trace costs one load
+#ifdef CHESS_TRACE
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SPAN(name) TraceSpan TRACE_CONCAT(trace_span_, __LINE__)(name)
+#else
+#define TRACE_SPAN(name) ((void)0)
+#endif
+
+void set_tracing(bool enabled);
+bool tracing_enabled();
+// false if compiled without CHESS_TRACE (then nothing is ever recorded)
+bool tracing_compiled();
+// nanoseconds since the start of the program (never 0)
+uint64_t trace_now();
+// stores a finished span in the ring buffer of the calling thread
+void trace_record(const char* name, uint64_t start, uint64_t end);
+
+// writes all recorded spans in the Chrome trace event format
+// (open with chrome://tracing or https://ui.perfetto.dev)
+void write_trace_json(std::ostream& out);
+
+/// <summary>
+/// records the time between its construction and destruction as a span
+/// (name must be a string literal, only the pointer is stored)
+/// </summary>
+class TraceSpan {
+private:
+  const char* name;
+  uint64_t start;
+
+public:
+  TraceSpan(const char* name) : name(name), start(tracing_enabled() ? trace_now() : 0) {}
+  ~TraceSpan() {
+    if (start != 0) {
+      trace_record(name, start, trace_now());
+    }
+  }
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+};
@@ -0,0 +1,33 @@
+#include "TranspositionTable.h"
+
+#include <algorithm>
+
+TranspositionTable::TranspositionTable(size_t megabytes) {
+  // round down to a power of two, so the slot is just the masked key
+  size_t count = 1;
+  while (count * 2 * sizeof(TableEntry) <= megabytes * 1024 * 1024) {
+    count *= 2;
+  }
+  entries.resize(count);
+  mask = count - 1;
+}
+
+void TranspositionTable::clear() {
+  std::fill(entries.begin(), entries.end(), TableEntry());
+}
+
+bool TranspositionTable::probe(uint64_t key, TableEntry& entry) const {
+  const TableEntry& slot = entries[key & mask];
+  if (slot.key != key || slot.depth < 0) {
+    return false;
+  }
+  entry = slot;
+  return true;
+}
+
+void TranspositionTable::store(uint64_t key, int depth, int score, Bound bound, const Move& move) {
+  TableEntry& slot = entries[key & mask];
+  // keep the old best move if this result has none
+  Move best = move.from >= 0 || slot.key != key ? move : slot.move;
+  slot = { key, score, static_cast<int16_t>(depth), bound, best };
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Chessboard.h"
+
+// how a stored score relates to the real one
+enum class Bound : uint8_t { EXACT, LOWER, UPPER };
+
+struct TableEntry {
+  uint64_t key = 0;
+  int32_t score = 0;
+  int16_t depth = -1;
+  Bound bound = Bound::EXACT;
+  Move move = { -1, -1 };
+};
+
+/// <summary>
+/// remembers search results per position key (always-replace, one entry per
+/// slot); kept between searches so later searches start warm
+/// </summary>
+class TranspositionTable {
+private:
+  std::vector<TableEntry> entries;
+  size_t mask;
+
+public:
+  TranspositionTable(size_t megabytes = 16);
+
+  void clear();
+  bool probe(uint64_t key, TableEntry& entry) const;
+  void store(uint64_t key, int depth, int score, Bound bound, const Move& move);
+};
@@ -0,0 +1,259 @@
+#include "Validation.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "BatchBoards.h"
+#include "Chessboard.h"
+#include "Chesspiece.h"
+#include "WorkStealingPool.h"
+#include "Zobrist.h"
+
+constexpr int GAME_LENGTH = 200; // plies per random game
+constexpr int SMALLEST_SIZE = MIN_BOARD_SIZE;
+constexpr int LARGEST_SIZE = MAX_BOARD_SIZE;
+
+static uint64_t next_random(uint64_t& state) {
+  state = zobrist_mix(state);
+  return state;
+}
+
+/// <summary>
+/// the start position with a hopper and a quadrilateral per color on random
+/// empty squares of the own half
+/// </summary>
+static std::string start_position(const Chessboard& board, uint64_t& random) {
+  int size = board.get_size();
+  std::string squares(size * size, '.');
+  for (int color = 0; color < 2; color++) {
+    for (int square : board.get_piece_squares(color == 1)) {
+      char letter = board.piece_at(square)->get_letter();
+      squares[square] = color == 1 ? letter : static_cast<char>(std::tolower(letter));
+    }
+  }
+  for (char letter : std::string("HUhu")) {
+    bool is_white = std::isupper(static_cast<unsigned char>(letter)) != 0;
+    int first_col = is_white ? size / 2 : 2; // internal columns count from black's side
+    int last_col = is_white ? size - 3 : size / 2 - 1;
+    int square;
+    do {
+      int col = first_col + static_cast<int>(next_random(random) % (last_col - first_col + 1));
+      square = board.at(static_cast<int>(next_random(random) % size), col);
+    } while (squares[square] != '.');
+    squares[square] = letter;
+  }
+
+  std::string fen;
+  for (int col = 0; col < size; col++) {
+    int empty = 0;
+    for (int row = 0; row < size; row++) {
+      char letter = squares[board.at(row, col)];
+      if (letter == '.') {
+        empty++;
+        continue;
+      }
+      if (empty > 0) {
+        fen += std::to_string(empty);
+        empty = 0;
+      }
+      fen += letter;
+    }
+    if (empty > 0) {
+      fen += std::to_string(empty);
+    }
+    fen += col + 1 < size ? '/' : ' ';
+  }
+  return fen + 'w';
+}
+
+// with CHECKMATE: may an enemy piece go to the king of the player who just moved?
+static bool own_king_attacked(const Chessboard& board) {
+  int size = board.get_size();
+  bool mover = !board.is_whites_turn();
+  for (int king : board.get_piece_squares(mover)) {
+    if (!board.piece_at(king)->is_essential()) {
+      continue;
+    }
+    for (int square : board.get_piece_squares(!mover)) {
+      if (board.piece_at(square)->can_move(square % size, square / size, king % size, king / size, board)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+/// <summary>
+/// all moves by the reference rules: can_move for every piece of the player
+/// on turn and every square of the board
+/// </summary>
+static void reference_moves(Chessboard& board, std::vector<Move>& moves) {
+  moves.clear();
+  int size = board.get_size();
+  // a copy: trying out moves reorders the piece lists
+  std::vector<int> pieces = board.get_piece_squares(board.is_whites_turn());
+  for (int from : pieces) {
+    const Chesspiece* cp = board.piece_at(from);
+    for (int to = 0; to < size * size; to++) {
+      if (!cp->can_move(from % size, from / size, to % size, to / size, board)) {
+        continue;
+      }
+      if (board.get_rules() == RuleSet::CHECKMATE) {
+        Chesspiece* captured = board.make_move({ from, to });
+        bool illegal = own_king_attacked(board);
+        board.unmake_move({ from, to }, captured);
+        if (illegal) {
+          continue;
+        }
+      }
+      moves.push_back({ from, to });
+    }
+  }
+}
+
+static bool move_less(const Move& a, const Move& b) {
+  return a.from != b.from ? a.from < b.from : a.to < b.to;
+}
+
+// the moves only in first (extra) and only in second (missing); sorts both
+static void compare_moves(std::vector<Move>& first, std::vector<Move>& second,
+  std::vector<Move>& extra, std::vector<Move>& missing) {
+  std::sort(first.begin(), first.end(), move_less);
+  std::sort(second.begin(), second.end(), move_less);
+  extra.clear();
+  missing.clear();
+  std::set_difference(first.begin(), first.end(), second.begin(), second.end(),
+    std::back_inserter(extra), move_less);
+  std::set_difference(second.begin(), second.end(), first.begin(), first.end(),
+    std::back_inserter(missing), move_less);
+}
+
+static std::string moves_to_string(const Chessboard& board, const std::vector<Move>& moves) {
+  std::string text;
+  for (const Move& move : moves) {
+    text += ' ' + board.move_to_string(move);
+  }
+  return moves.empty() ? " -" : text;
+}
+
+/// <summary>
+/// plays one random game and compares every position on the way (with
+/// CAPTURE_KING also the moves of BatchBoards); returns the report of the
+/// first mismatch or an empty string
+/// </summary>
+static std::string check_game(uint64_t game, const ValidationSettings& settings,
+  std::atomic<uint64_t>& checked, const std::atomic<bool>& failed) {
+  uint64_t random = game;
+  const uint64_t sizes = LARGEST_SIZE - SMALLEST_SIZE + 1;
+  int size = SMALLEST_SIZE + static_cast<int>(game % sizes);
+  RuleSet rules = game / sizes % 2 == 0 ? RuleSet::CAPTURE_KING : RuleSet::CHECKMATE;
+  // every other round of sizes and rule sets without the fairy pieces: a
+  // fairy 'H' or 'U' takes the place of the built-in hopper or quadrilateral
+  const std::vector<PieceDefinition> no_fairy_pieces;
+  bool with_fairy_pieces = game / (2 * sizes) % 2 == 1;
+  Chessboard board(false, size, rules, with_fairy_pieces ? settings.fairy_pieces : no_fairy_pieces);
+  std::string fen = start_position(board, random);
+  if (!board.set_fen(fen)) {
+    return "Start position of game " + std::to_string(game) + " could not be set up:\n  fen " + fen;
+  }
+
+  // the batch plays by the capture rules only
+  std::unique_ptr<BatchBoards> batch;
+  if (rules == RuleSet::CAPTURE_KING) {
+    batch.reset(new BatchBoards(1, size, board.get_fairy_pieces()));
+  }
+
+  std::vector<Move> moves, generated, reference, batch_moves, extra, missing;
+  for (int ply = 0; ply < GAME_LENGTH && !failed && checked < settings.positions; ply++) {
+    auto mismatch = [&]() {
+      return "Mismatch in game " + std::to_string(game) + " after " + std::to_string(ply) + " plies (size " +
+        std::to_string(size) + ", rules " + (rules == RuleSet::CHECKMATE ? "checkmate" : "capture") + "):\n" +
+        "  fen " + board.get_fen() + "\n";
+    };
+    board.generate_moves(moves);
+    reference_moves(board, reference);
+    generated = moves;
+    compare_moves(generated, reference, extra, missing);
+    if (!extra.empty() || !missing.empty()) {
+      return mismatch() +
+        "  generated, but not allowed by can_move:" + moves_to_string(board, extra) + "\n" +
+        "  allowed by can_move, but not generated:" + moves_to_string(board, missing);
+    }
+    if (batch != nullptr) {
+      if (!batch->generate_moves(board, batch_moves)) {
+        return mismatch() + "  the position does not fit BatchBoards";
+      }
+      compare_moves(batch_moves, generated, extra, missing);
+      if (!extra.empty() || !missing.empty()) {
+        return mismatch() +
+          "  generated by BatchBoards, but not by Chessboard:" + moves_to_string(board, extra) + "\n" +
+          "  generated by Chessboard, but not by BatchBoards:" + moves_to_string(board, missing);
+      }
+    }
+    checked++;
+    if (moves.empty() || board.is_game_over() != GameState::PLAY_ON) {
+      break;
+    }
+    delete board.make_move(moves[next_random(random) % moves.size()]);
+  }
+  return "";
+}
+
+bool validate_move_generation(const ValidationSettings& settings, std::ostream& out) {
+  auto start = std::chrono::steady_clock::now();
+  std::atomic<uint64_t> checked{ 0 };
+  std::atomic<uint64_t> next_game{ 0 };
+  std::atomic<bool> failed{ false };
+  std::mutex mutex;
+  uint64_t failed_game = UINT64_MAX;
+  std::string report;
+  {
+    // every thread takes the next game number until enough positions are checked
+    WorkStealingPool pool(settings.threads);
+    for (int i = 0; i < pool.get_thread_count(); i++) {
+      pool.submit([&](int) {
+        while (!failed && checked < settings.positions) {
+          uint64_t game = next_game++;
+          std::string mismatch = check_game(game, settings, checked, failed);
+          if (!mismatch.empty()) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (game < failed_game) { // of several mismatches the earliest game is shown
+              failed_game = game;
+              report = mismatch;
+            }
+            failed = true;
+          }
+        }
+      });
+    }
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  if (failed) {
+    out << report << std::endl;
+    return false;
+  }
+  out << checked << " positions of " << next_game << " games (sizes " << SMALLEST_SIZE << " to " << LARGEST_SIZE
+    << ") checked in " << seconds << " s: the generated moves agree with can_move"
+    << " (and those of BatchBoards with Chessboard)." << std::endl;
+  out << "Pieces checked: built-in KQRBNPHU";
+  if (!settings.fairy_pieces.empty()) {
+    // the games with fairy pieces start after the first round without them
+    if (next_game > 2 * (LARGEST_SIZE - SMALLEST_SIZE + 1)) {
+      out << ", fairy ";
+      for (const PieceDefinition& definition : settings.fairy_pieces) {
+        out << definition.symbol;
+      }
+    }
+    else {
+      out << " (too few positions for the fairy pieces)";
+    }
+  }
+  out << '.' << std::endl;
+  return true;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "PieceDefinition.h"
+
+struct ValidationSettings {
+  uint64_t positions = 1000000;
+  int threads = 0; // 0: one per hardware thread
+  std::vector<PieceDefinition> fairy_pieces;
+};
+
+/// <summary>
+/// compares Chessboard::generate_moves with the reference rules of
+/// Chesspiece::can_move, probed for every piece and every square, in
+/// positions of random games on boards of size 8 to 26. Hoppers and
+/// quadrilaterals are added to the start position, so all eight classes
+/// take part; the fairy pieces are added in every other round of sizes and
+/// rule sets only, since a fairy 'H' or 'U' replaces the built-in figure. Games alternate between the rule sets;
+/// with CHECKMATE a move is only legal if afterwards no enemy piece can_move
+/// onto the own king. In the CAPTURE_KING games the moves of BatchBoards
+/// are compared with generate_moves as well, since the batch has a move
+/// generator of its own. Stops at the first mismatch and prints it with the
+/// position as fen (for "position fen" or --analyze). True if all agreed.
+/// </summary>
+bool validate_move_generation(const ValidationSettings& settings, std::ostream& out);
@@ -0,0 +1,100 @@
+#include "WorkStealingPool.h"
+
+#include <algorithm>
+
+#include "Trace.h"
+
+WorkStealingPool::WorkStealingPool(int thread_count) {
+  if (thread_count <= 0) {
+    thread_count = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  }
+  for (int i = 0; i < thread_count; i++) {
+    queues.emplace_back(new Queue);
+  }
+  for (int i = 0; i < thread_count; i++) {
+    threads.emplace_back(&WorkStealingPool::run, this, i);
+  }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  wait();
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex);
+    stopping = true;
+  }
+  wake_up.notify_all();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+/// <summary>
+/// spreads new tasks round robin; whoever runs out of work steals them anyway
+/// </summary>
+void WorkStealingPool::submit(Task task) {
+  Queue& queue = *queues[next_queue++ % queues.size()];
+  unfinished++;
+  {
+    // counted first and under the sleep lock: a thread cannot miss the wake
+    // up between looking at queued and going to sleep, and queued never
+    // drops below the tasks in the queues
+    std::lock_guard<std::mutex> lock(sleep_mutex);
+    queued++;
+  }
+  {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.push_back(std::move(task));
+  }
+  wake_up.notify_one();
+}
+
+void WorkStealingPool::wait() {
+  std::unique_lock<std::mutex> lock(sleep_mutex);
+  all_done.wait(lock, [this] { return unfinished == 0; });
+}
+
+bool WorkStealingPool::take(int worker, Task& task) {
+  {
+    Queue& own = *queues[worker];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      task = std::move(own.tasks.front());
+      own.tasks.pop_front();
+      return true;
+    }
+  }
+  for (size_t i = 1; i < queues.size(); i++) {
+    Queue& other = *queues[(worker + i) % queues.size()];
+    std::lock_guard<std::mutex> lock(other.mutex);
+    if (!other.tasks.empty()) {
+      task = std::move(other.tasks.front());
+      other.tasks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkStealingPool::run(int worker) {
+  Task task;
+  while (true) {
+    if (take(worker, task)) {
+      queued--;
+      {
+        TRACE_SPAN("pool_task");
+        task(worker);
+      }
+      task = nullptr;
+      if (--unfinished == 0) {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        all_done.notify_all();
+      }
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleep_mutex);
+    wake_up.wait(lock, [this] { return stopping || queued > 0; });
+    if (stopping && queued == 0) {
+      return;
+    }
+  }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// fixed set of threads, each with its own task queue. A thread works off
+/// its own queue in submission order and, when that is empty, steals from
+/// the front of the others, so one expensive task never holds up the cheap
+/// ones queued behind it and the tasks finish roughly in the order they
+/// were submitted (results can be streamed in that order). Tasks learn the number of the thread running
+/// them, e.g. to use per-thread search tables.
+/// </summary>
+class WorkStealingPool {
+public:
+  using Task = std::function<void(int worker)>;
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> threads;
+  std::atomic<size_t> queued{ 0 };   // tasks not yet taken by a thread
+  std::atomic<size_t> unfinished{ 0 };
+  std::atomic<size_t> next_queue{ 0 };
+  std::mutex sleep_mutex;
+  std::condition_variable wake_up;   // new tasks or stopping
+  std::condition_variable all_done;
+  bool stopping = false;
+
+  bool take(int worker, Task& task);
+  void run(int worker);
+
+public:
+  // 0 threads: one per hardware thread
+  WorkStealingPool(int thread_count = 0);
+  // finishes all submitted tasks before the threads end
+  ~WorkStealingPool();
+
+  int get_thread_count() const { return static_cast<int>(threads.size()); }
+  void submit(Task task);
+  // blocks until every submitted task has finished
+  void wait();
+};
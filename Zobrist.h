@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+// position keys are built from pseudo random numbers per (figure, color, square);
+// they are computed on the fly (splitmix64) instead of kept in tables, so they
+// do not depend on the board size or the set of fairy pieces
+
+inline uint64_t zobrist_mix(uint64_t x) {
+  x += 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+inline uint64_t zobrist_piece(char symbol, bool is_white, int square) {
+  return zobrist_mix((static_cast<uint64_t>(square) << 8) |
+    (static_cast<uint64_t>(static_cast<unsigned char>(symbol)) << 1) | (is_white ? 1 : 0));
+}
+
+// xor-ed into the key when black is on turn
+constexpr uint64_t ZOBRIST_BLACK_TO_MOVE = 0xF1E2D3C4B5A69788ULL;